@@ -0,0 +1,47 @@
+""" Benchmarks of the software binning and cropping kernels in catkit.util on full 4k x 4k frames.
+
+Run with:
+    python benchmarks/bench_binning.py [--repeat N]
+"""
+import argparse
+import timeit
+
+import numpy as np
+
+import catkit.util
+
+
+def reshape_sum(data, bins_y, bins_x):
+    """ The naive kernel, for comparison. """
+    height, width = data.shape[0] // bins_y, data.shape[1] // bins_x
+    return data[:height * bins_y, :width * bins_x].reshape(height, bins_y, width, bins_x).sum(axis=(1, 3),
+                                                                                              dtype=np.float32)
+
+
+def time_it(function, repeat):
+    return min(timeit.repeat(function, number=1, repeat=repeat)) * 1e3
+
+
+def main(repeat=10, shape=(4096, 4096)):
+    data = np.random.default_rng(0).integers(0, 2**16, size=shape, dtype=np.uint16)
+
+    print(f"{shape[0]}x{shape[1]} uint16 frame, best of {repeat} (ms)")
+    print(f"{'kernel':<28}{'bin_image':>12}{'reshape-sum':>14}{'speedup':>10}")
+    for bins in (2, 4, 8, (2, 4)):
+        bins_y, bins_x = (bins, bins) if np.isscalar(bins) else bins
+        out = np.empty((shape[0] // bins_y, shape[1] // bins_x), dtype=np.float32)
+        for method in ("sum", "mean"):
+            fast = time_it(lambda: catkit.util.bin_image(data, bins, method=method, out=out), repeat)
+            naive = time_it(lambda: reshape_sum(data, bins_y, bins_x), repeat)
+            print(f"{f'bin {bins_y}x{bins_x} {method}':<28}{fast:>12.2f}{naive:>14.2f}{naive / fast:>9.1f}x")
+
+    crop = time_it(lambda: catkit.util.crop_image(data, shape[1] // 2, shape[0] // 2, 512, 512), repeat)
+    copy = time_it(lambda: catkit.util.crop_image(data, shape[1] // 2, shape[0] // 2, 512, 512).copy(), repeat)
+    print(f"{'crop 512x512 (view)':<28}{crop:>12.4f}")
+    print(f"{'crop 512x512 (copy)':<28}{copy:>12.4f}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--repeat", type=int, default=10)
+    main(repeat=parser.parse_args().repeat)
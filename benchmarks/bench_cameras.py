@@ -0,0 +1,173 @@
+""" End-to-end benchmarks of camera acquisition, running the real camera classes against their emulators: ZwoCamera
+against the ZwoEmulator (synthetic images, instantaneous exposures) and SbigCamera over HTTP against an SbigEmulator
+served on localhost.
+
+Sweeps ROI size, binning, video vs snapshot mode (ZWO), pipelining (SBIG) and file mode, and reports as JSON, per
+configuration. ZWO file mode is only measured in video mode, as ZwoCamera.take_exposures() always streams in video
+mode:
+ * fps: Frames per second, end to end.
+ * latency_p50/95/99: Time (seconds) from requesting a frame (i.e., next() on the stream) to receiving its numpy array,
+   including the exposure. Not available in file mode, which times take_exposures() as a whole.
+ * cpu_per_frame: Process CPU time (seconds, all threads) per frame.
+ * alloc_bytes_per_frame: Median peak of memory allocated (traced by tracemalloc) whilst acquiring a frame, measured in
+   a separate, shorter run as tracing slows acquisition down.
+
+Run with:
+    python benchmarks/bench_cameras.py [--frames N] [--quick] [--output results.json]
+"""
+import argparse
+import itertools
+import json
+import os
+import tempfile
+import time
+import tracemalloc
+
+import numpy as np
+
+from catkit.catkit_types import quantity, units
+import catkit.config
+from catkit.emulators.SbigCamera import SbigEmulator, SbigHTTPServer
+import catkit.emulators.ZwoCamera
+import catkit.hardware.sbig.SbigCamera
+import catkit.hardware.zwo.ZwoCamera
+from catkit.interfaces.Instrument import SimInstrument
+
+CONFIG_FILENAME = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir, "catkit", "emulators", "tests",
+                               "config.ini")
+ZWO_CONFIG_ID = "zwo_ASI178MM_3"
+SBIG_CONFIG_ID = "sbig_stx16803"
+
+
+class ZwoEmulator(catkit.emulators.ZwoCamera.ZwoEmulator):
+    implemented_camera_purposes = ("imaging_camera",)
+    image_generator_kwargs = {"seed": 0}
+
+
+class ZwoCamera(SimInstrument, catkit.hardware.zwo.ZwoCamera.ZwoCamera):
+    instrument_lib = ZwoEmulator
+
+    @classmethod
+    def load_asi_lib(cls):
+        pass
+
+
+def num_frames(frames, size, bins):
+    """ Scale the number of frames down for large images, keeping the number of pixels roughly constant. """
+    return int(np.clip(frames * 256**2 / (size // bins)**2, 10, frames))
+
+
+def time_stream(stream, frames):
+    """ Time frames of a stream, returning latencies & the wall & CPU times of the whole. """
+    latencies = np.empty(frames)
+    start, cpu_start = time.perf_counter(), time.process_time()
+    stream = iter(stream)
+    for i in range(frames):
+        request = time.perf_counter()
+        next(stream)
+        latencies[i] = time.perf_counter() - request
+    wall, cpu = time.perf_counter() - start, time.process_time() - cpu_start
+    stream.close()
+    return latencies, wall, cpu
+
+
+def trace_allocations(stream, frames):
+    """ Median peak of memory allocated per frame of a stream. """
+    peaks = []
+    stream = iter(stream)
+    tracemalloc.start()
+    try:
+        for _ in range(frames):
+            current, _ = tracemalloc.get_traced_memory()
+            tracemalloc.reset_peak()
+            next(stream)
+            peaks.append(tracemalloc.get_traced_memory()[1] - current)
+    finally:
+        tracemalloc.stop()
+        stream.close()
+    return int(np.median(peaks))
+
+
+def result(parameters, frames, wall, cpu, latencies=None, allocations=None):
+    entry = dict(parameters, frames=frames, fps=frames / wall, cpu_per_frame=cpu / frames,
+                 alloc_bytes_per_frame=allocations)
+    for percentile in (50, 95, 99):
+        entry[f"latency_p{percentile}"] = None if latencies is None else float(np.percentile(latencies, percentile))
+    return entry
+
+
+def run(camera, parameters, exposure_time, frames, file_mode, directory, **kwargs):
+    """ Benchmark a single configuration of a camera. """
+    if file_mode:
+        start, cpu_start = time.perf_counter(), time.process_time()
+        camera.take_exposures(exposure_time, frames, file_mode=True, path=directory, filename="bench.fits", **kwargs)
+        return result(parameters, frames, time.perf_counter() - start, time.process_time() - cpu_start)
+
+    # Warm up, e.g., to set up the camera & allocate buffers.
+    time_stream(camera.stream_exposures(exposure_time, 2, **kwargs), 2)
+    latencies, wall, cpu = time_stream(camera.stream_exposures(exposure_time, frames, **kwargs), frames)
+    allocation_frames = min(frames, 20)
+    allocations = trace_allocations(camera.stream_exposures(exposure_time, allocation_frames, **kwargs),
+                                    allocation_frames)
+    return result(parameters, frames, wall, cpu, latencies=latencies, allocations=allocations)
+
+
+def bench_zwo(frames, sizes, bins_list, directory):
+    results = []
+    with ZwoCamera(config_id=ZWO_CONFIG_ID) as camera:
+        for size, bins, video, file_mode in itertools.product(sizes, bins_list, (True, False), (False, True)):
+            parameters = dict(camera="zwo", size=size, bins=bins, video=video, file_mode=file_mode)
+            kwargs = dict(width=size, height=size, bins=bins, subarray_x=2048, subarray_y=2048, full_image=False)
+            if not file_mode:
+                kwargs["use_video_capture_mode"] = video
+            elif not video:
+                # ZwoCamera.take_exposures() always streams in video mode, so file mode with snapshots isn't measured.
+                continue
+            results.append(run(camera, parameters, quantity(1, units.millisecond), num_frames(frames, size, bins),
+                               file_mode, directory, **kwargs))
+            print(json.dumps(results[-1]), flush=True)
+    return results
+
+
+def bench_sbig(frames, sizes, bins_list, directory, readout_time=0.001):
+    results = []
+    emulator = SbigEmulator(config_id=SBIG_CONFIG_ID, readout_time=readout_time)
+    with SbigHTTPServer(emulator) as server:
+        catkit.config.CONFIG_INI.set(SBIG_CONFIG_ID, "base_url", server.base_url)
+        with catkit.hardware.sbig.SbigCamera.SbigCamera(config_id=SBIG_CONFIG_ID) as camera:
+            for size, bins, pipelined, file_mode in itertools.product(sizes, bins_list, (False, True), (False, True)):
+                parameters = dict(camera="sbig", size=size, bins=bins, pipelined=pipelined, file_mode=file_mode)
+                kwargs = dict(width=size, height=size, bins=bins, subarray_x=2048, subarray_y=2048, full_image=False,
+                              pipelined=pipelined)
+                results.append(run(camera, parameters, quantity(1, units.millisecond),
+                                   num_frames(frames, size, bins) // 4, file_mode, directory, **kwargs))
+                print(json.dumps(results[-1]), flush=True)
+    return results
+
+
+def main(frames=200, quick=False, output=None, cameras=("zwo", "sbig")):
+    catkit.config.load_config_ini(CONFIG_FILENAME)
+    sizes = (64, 256) if quick else (64, 256, 1024)
+    bins_list = (1,) if quick else (1, 2)
+
+    results = []
+    with tempfile.TemporaryDirectory() as directory:
+        if "zwo" in cameras:
+            results += bench_zwo(frames, sizes, bins_list, directory)
+        if "sbig" in cameras:
+            results += bench_sbig(frames, sizes, bins_list, directory)
+
+    if output:
+        with open(output, "w") as f:
+            json.dump(results, f, indent=2)
+    return results
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--frames", type=int, default=200, help="Frames per configuration, fewer for large images.")
+    parser.add_argument("--quick", action="store_true", help="Sweep fewer configurations.")
+    parser.add_argument("--camera", choices=("zwo", "sbig"), action="append", help="Only benchmark these cameras.")
+    parser.add_argument("--output", help="Write the results to this JSON file, as well as stdout (one per line).")
+    args = parser.parse_args()
+    main(frames=args.frames, quick=args.quick, output=args.output, cameras=args.camera or ("zwo", "sbig"))
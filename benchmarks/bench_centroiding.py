@@ -0,0 +1,62 @@
+""" Benchmarks of the centroiding methods of catkit.centroiding against photutils' Gaussian fits, for speed and
+accuracy, on noisy synthetic spots at random sub-pixel positions (see catkit.emulators.synthetic_images).
+
+Each method is timed on the full image and within a region of interest around the (true) previous position, as the
+picomotor calibration does with centroid_roi_size. The photutils methods are skipped if photutils isn't installed.
+
+Run with:
+    python benchmarks/bench_centroiding.py [--spots N] [--size PIXELS] [--roi PIXELS]
+"""
+import argparse
+import time
+
+import numpy as np
+
+from catkit import centroiding
+from catkit.emulators.synthetic_images import SyntheticImageGenerator
+
+METHODS = ("com", "thresholded_com", "windowed_com", "quadratic", "1d", "2d")
+
+
+def make_spots(num_spots, size, fwhm=4, seed=0):
+    rng = np.random.default_rng(seed)
+    positions = rng.uniform(size / 4, 3 * size / 4, (num_spots, 2))
+    images = [SyntheticImageGenerator(shape=(size, size), sources=[(x, y, 1e7, fwhm)], hot_pixel_fraction=0,
+                                      bit_depth=16, seed=seed + i).generate(0.01)
+              for i, (x, y) in enumerate(positions)]
+    # Subtract the bias, as the background is for real images.
+    return [image.astype(np.float32) - 100 for image in images], positions
+
+
+def main(num_spots=50, size=512, roi=32):
+    images, positions = make_spots(num_spots, size)
+
+    print(f"{num_spots} spots in {size}x{size} images, ROI of {roi}x{roi}")
+    print(f"{'method':<18}{'full (ms)':>12}{'roi (ms)':>12}{'rms error (pix)':>18}")
+    for name in METHODS:
+        try:
+            method = centroiding.get_method(name)
+            x, y = method(images[0])
+            float(x), float(y)
+        except Exception as error:
+            print(f"{name:<18}skipped ({error.__class__.__name__}: {error})")
+            continue
+
+        timings = []
+        for center in (None, True):
+            start = time.perf_counter()
+            results = [centroiding.centroid(image, method, center=None if center is None else position,
+                                            size=None if center is None else roi)
+                       for image, position in zip(images, positions)]
+            timings.append((time.perf_counter() - start) / num_spots * 1e3)
+        error = np.sqrt(np.mean(np.sum((np.asarray(results, dtype=float) - positions)**2, axis=1)))
+        print(f"{name:<18}{timings[0]:>12.3f}{timings[1]:>12.3f}{error:>18.4f}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--spots", type=int, default=50)
+    parser.add_argument("--size", type=int, default=512)
+    parser.add_argument("--roi", type=int, default=32)
+    args = parser.parse_args()
+    main(num_spots=args.spots, size=args.size, roi=args.roi)
@@ -0,0 +1,38 @@
+""" Benchmarks of the synthetic image generator (catkit.emulators.synthetic_images) used by the camera emulators.
+
+Run with:
+    python benchmarks/bench_synthetic_images.py [--frames N]
+"""
+import argparse
+import time
+
+import numpy as np
+
+from catkit.emulators.synthetic_images import SyntheticImageGenerator
+
+
+def main(frames=1000):
+    generator = SyntheticImageGenerator(seed=0)
+
+    print(f"{'region':<16}{'signal (ms)':>14}{'frames/s':>12}{'MPix/s':>10}")
+    for size in (32, 64, 128, 256, 512, 1024, 4096):
+        roi = dict(start_x=(generator.shape[1] - size) // 2, start_y=(generator.shape[0] - size) // 2, width=size,
+                   height=size)
+        out = np.empty((size, size), dtype=np.uint16)
+
+        start = time.perf_counter()
+        generator.signal(**roi)
+        signal_time = time.perf_counter() - start
+
+        num_frames = max(3, frames * 64**2 // size**2)
+        start = time.perf_counter()
+        for _ in range(num_frames):
+            generator.generate(0.01, out=out, **roi)
+        fps = num_frames / (time.perf_counter() - start)
+        print(f"{f'{size}x{size}':<16}{signal_time * 1e3:>14.2f}{fps:>12.0f}{fps * size**2 / 1e6:>10.1f}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--frames", type=int, default=1000, help="Frames to time at 64x64, scaled by region size.")
+    main(frames=parser.parse_args().frames)
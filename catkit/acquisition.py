@@ -0,0 +1,625 @@
+"""Building blocks for streaming frames from cameras."""
+
+from collections import deque, namedtuple
+import queue
+import threading
+import time
+
+import numpy as np
+
+
+# When and in which order a frame was captured, see StreamStatistics.
+# sequence is the index of the frame within its stream, timestamp is time.monotonic() (seconds) just after capture and
+# dropped is the driver's count of frames it dropped since the stream started, None if the driver doesn't tell.
+FrameInfo = namedtuple("FrameInfo", ["sequence", "timestamp", "dropped"])
+
+
+def monotonic_to_epoch(timestamp):
+    """ Convert a time.monotonic() timestamp, e.g., FrameInfo.timestamp, to seconds since the epoch (as time.time()). """
+    return time.time() - (time.monotonic() - timestamp)
+
+
+class Frame:
+    """ A single slot of a FrameRingBuffer.
+
+    `data` is a numpy view onto the preallocated `buffer` and is only valid until the frame is released back to its
+    ring, after which the slot gets overwritten by a later capture. Frames can be used as context managers to release
+    them on exit.
+    """
+
+    def __init__(self, ring, index, buffer, data):
+        self.ring = ring
+        self.index = index
+        self.buffer = buffer
+        self.data = data
+        self.in_use = False
+        # catkit.acquisition.FrameInfo of the capture currently held in this slot, if known.
+        self.info = None
+
+    def release(self):
+        """ Return this slot to its ring. Releasing an already released frame is a NOOP. """
+        if self.in_use:
+            self.in_use = False
+            self.ring.release(self)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exception_type, exception_value, exception_traceback):
+        self.release()
+
+
+class FrameRingBuffer:
+    """ A fixed pool of preallocated frame buffers recycled between a producer (the camera) and its consumers.
+
+    Each slot is a bytearray, such that it can be handed to drivers that fill a given buffer, e.g.,
+    zwoasi.Camera.capture_video_frame(buffer_), along with a numpy view of it. The producer acquires a free slot,
+    fills it and hands the Frame to a consumer, who releases it once done with it. This class is thread safe.
+
+    Parameters
+    ----------
+    shape : tuple
+        Shape of each frame.
+    dtype : np.dtype
+        Data type of each frame.
+    num_slots : int
+        Number of frames in the ring. This bounds the number of frames that can be held by consumers at any one time.
+    """
+
+    def __init__(self, shape, dtype=np.uint16, num_slots=4):
+        if num_slots < 1:
+            raise ValueError(f"Expected at least one slot but got '{num_slots}'")
+
+        self.shape = tuple(shape)
+        self.dtype = np.dtype(dtype)
+        self.num_slots = num_slots
+
+        nbytes = int(np.prod(self.shape)) * self.dtype.itemsize
+        self._free = queue.Queue()
+        self.slots = []
+        for index in range(num_slots):
+            buffer = bytearray(nbytes)
+            data = np.frombuffer(buffer, dtype=self.dtype).reshape(self.shape)
+            frame = Frame(self, index, buffer, data)
+            self.slots.append(frame)
+            self._free.put(frame)
+
+    @property
+    def num_free(self):
+        return self._free.qsize()
+
+    def matches(self, shape, dtype):
+        """ Whether frames of the given shape and dtype fit this ring. """
+        return tuple(shape) == self.shape and np.dtype(dtype) == self.dtype
+
+    def acquire(self, block=True, timeout=None):
+        """ Get a free slot to capture into. Blocks (see queue.Queue.get()) until one is released if all are in use.
+
+        Raises
+        ------
+        RuntimeError
+            If no slot became free, i.e., consumers are holding on to every frame.
+        """
+        try:
+            frame = self._free.get(block=block, timeout=timeout)
+        except queue.Empty:
+            raise RuntimeError(f"All {self.num_slots} frame buffers are in use, frames must be released "
+                               "by their consumers.") from None
+        frame.in_use = True
+        return frame
+
+    def release(self, frame):
+        """ Return a slot to the ring. Prefer calling Frame.release(). """
+        if frame.ring is not self:
+            raise ValueError("Frame does not belong to this ring.")
+        self._free.put(frame)
+
+
+class BackgroundAcquisition:
+    """ Drains a stream of frames on a producer thread into a bounded queue, such that capture and the processing of
+    frames by the consumer overlap.
+
+    Iterating over this object yields the frames in order, as the wrapped stream would. Exceptions raised by the stream
+    are re-raised to the consumer, after all frames captured before them were yielded. When the consumer stops
+    iterating, the producer is stopped and the wrapped stream closed (on the producer thread).
+
+    WARNING: The device behind the stream must not otherwise be used while this is running.
+
+    Parameters
+    ----------
+    frames : iterable
+        The stream of frames to drain, e.g., a generator capturing from a camera.
+    maxsize : int
+        Maximum number of frames held in the queue.
+    backpressure : str
+        What to do when the queue is full: "block" pauses the producer until the consumer catches up, "drop_oldest"
+        discards the oldest queued frame (counted in self.dropped_frames) to make room for the newest one.
+    on_discard : callable, optional
+        Called with each frame that is dropped, or left over when stopping, e.g., to release ring buffer frames.
+    """
+
+    BLOCK = "block"
+    DROP_OLDEST = "drop_oldest"
+
+    # How often (seconds) blocked producers & consumers check whether they should stop waiting.
+    poll_interval = 0.05
+
+    def __init__(self, frames, maxsize=8, backpressure=BLOCK, on_discard=None):
+        if backpressure not in (self.BLOCK, self.DROP_OLDEST):
+            raise ValueError(f"Expected backpressure to be one of '{self.BLOCK}' or '{self.DROP_OLDEST}' "
+                             f"but got '{backpressure}'")
+        if maxsize < 1:
+            raise ValueError(f"Expected maxsize >= 1 but got '{maxsize}'")
+
+        self.frames = frames
+        self.backpressure = backpressure
+        self.on_discard = on_discard
+        self.queue = queue.Queue(maxsize)
+        self.dropped_frames = 0
+
+        self._error = None
+        self._stop = threading.Event()
+        self._done = threading.Event()
+        self._thread = threading.Thread(target=self._produce, name=f"{self.__class__.__qualname__}", daemon=True)
+
+    @property
+    def error(self):
+        """ The exception raised by the stream (or by closing it), if any, which is re-raised to the consumer. """
+        return self._error
+
+    def start(self):
+        if not self._thread.is_alive() and not self._done.is_set():
+            self._thread.start()
+
+    def stop(self):
+        """ Stop the producer, wait for it to finish and discard any frames not yet consumed. """
+        self._stop.set()
+        if self._thread.is_alive():
+            self._thread.join()
+        while True:
+            try:
+                self._discard(self.queue.get_nowait())
+            except queue.Empty:
+                break
+
+    def __iter__(self):
+        self.start()
+        try:
+            while True:
+                try:
+                    frame = self.queue.get(timeout=self.poll_interval)
+                except queue.Empty:
+                    # Check for an empty queue again, the producer might have put its last frame just before finishing.
+                    if self._done.is_set() and self.queue.empty():
+                        break
+                    continue
+                yield frame
+
+            if self._error is not None:
+                raise self._error
+        finally:
+            self.stop()
+
+    def _produce(self):
+        try:
+            for frame in self.frames:
+                if self._stop.is_set():
+                    self._discard(frame)
+                    break
+                self._put(frame)
+        except BaseException as error:
+            self._error = error
+        finally:
+            try:
+                # Close the stream here, on the thread that ran it, e.g., to stop a camera's video capture.
+                close = getattr(self.frames, "close", None)
+                if close is not None:
+                    close()
+            except BaseException as error:
+                if self._error is None:
+                    self._error = error
+            finally:
+                self._done.set()
+
+    def _put(self, frame):
+        if self.backpressure == self.BLOCK:
+            while not self._stop.is_set():
+                try:
+                    self.queue.put(frame, timeout=self.poll_interval)
+                    return
+                except queue.Full:
+                    pass
+            # Nobody is consuming anymore.
+            self._discard(frame)
+        else:
+            while True:
+                try:
+                    self.queue.put_nowait(frame)
+                    return
+                except queue.Full:
+                    try:
+                        oldest = self.queue.get_nowait()
+                    except queue.Empty:
+                        continue
+                    self.dropped_frames += 1
+                    self._discard(oldest)
+
+    def _discard(self, frame):
+        if self.on_discard is not None:
+            self.on_discard(frame)
+
+
+class FrameSet(namedtuple("FrameSet", ["sequence", "images", "meta_data", "infos"])):
+    """ The n-th exposure of each of several cameras, see MultiCameraAcquisition.
+
+    images, meta_data & infos are dicts keyed by camera config_id, holding the image, its list of MetaDataEntry and its
+    FrameInfo, respectively.
+    """
+
+    __slots__ = ()
+
+    @property
+    def skew(self):
+        """ Spread (seconds) of the capture timestamps of the frames within this set. """
+        timestamps = [info.timestamp for info in self.infos.values()]
+        return max(timestamps) - min(timestamps)
+
+
+class MultiCameraAcquisition:
+    """ Captures from several cameras concurrently, on a thread per camera, such that the time taken is that of the
+    slowest camera rather than the sum over all of them.
+
+    Each camera runs its own stream_exposures() on its own BackgroundAcquisition thread. The threads meet at a barrier
+    before each exposure, such that the n-th exposures of all cameras are taken together and are yielded as a FrameSet.
+    In snapshot mode (use_video_capture_mode=False) this aligns the start of the exposures, in video mode that of their
+    readout. Driver calls (e.g., zwoasi's via ctypes) release the GIL, such that the cameras do capture in parallel.
+
+    WARNING: The cameras must not otherwise be used while this is streaming.
+
+    Parameters
+    ----------
+    cameras : list of catkit.interfaces.Camera
+        The opened cameras to capture from, keyed by their config_id within each FrameSet.
+    queue_size : int
+        Maximum number of frames queued per camera, i.e., how far ahead of the consumer capture may run.
+    """
+
+    def __init__(self, cameras, queue_size=2):
+        config_ids = [camera.config_id for camera in cameras]
+        if len(set(config_ids)) != len(config_ids):
+            raise ValueError(f"Expected distinct cameras but got '{config_ids}'")
+
+        self.cameras = {camera.config_id: camera for camera in cameras}
+        self.queue_size = queue_size
+
+    def stream_exposures(self, exposure_time, num_exposures, camera_kwargs=None, **kwargs):
+        """ Take exposures on all cameras at once and yield them as a FrameSet per exposure.
+
+        Parameters
+        ----------
+        exposure_time : Pint quantity, int, float or dict
+            Exposure time of all cameras, or a dict of those per camera config_id.
+        num_exposures : int
+            Number of exposures per camera.
+        camera_kwargs : dict, optional
+            Keyword arguments for the stream_exposures() of individual cameras, keyed by config_id. These take
+            precedence over kwargs.
+        kwargs :
+            Passed to the stream_exposures() of all cameras.
+
+        Yields
+        ------
+        FrameSet
+            The n-th exposure of each camera. The timestamps of its FrameInfos are those at which each camera handed
+            over its frame.
+        """
+        camera_kwargs = camera_kwargs or {}
+        unknown = set(camera_kwargs) - set(self.cameras)
+        if isinstance(exposure_time, dict):
+            unknown |= set(self.cameras) ^ set(exposure_time)
+        if unknown:
+            raise ValueError(f"Unknown or missing cameras '{sorted(unknown)}', expected {list(self.cameras)}")
+
+        barrier = threading.Barrier(len(self.cameras))
+        acquisitions = {}
+        for config_id, camera in self.cameras.items():
+            stream_kwargs = dict(kwargs, **camera_kwargs.get(config_id, {}))
+            camera_exposure_time = exposure_time[config_id] if isinstance(exposure_time, dict) else exposure_time
+            stream = camera.stream_exposures(camera_exposure_time, num_exposures, **stream_kwargs)
+            acquisitions[config_id] = BackgroundAcquisition(self._synchronize(stream, barrier), maxsize=self.queue_size)
+
+        # Start all at once, the first to start waits on the others at the barrier.
+        for acquisition in acquisitions.values():
+            acquisition.start()
+        iterators = {config_id: iter(acquisition) for config_id, acquisition in acquisitions.items()}
+        try:
+            for sequence in range(num_exposures):
+                images = {}
+                meta_data = {}
+                infos = {}
+                for config_id, iterator in iterators.items():
+                    try:
+                        images[config_id], meta_data[config_id], infos[config_id] = next(iterator)
+                    except StopIteration:
+                        raise RuntimeError(f"Camera '{config_id}' stopped after {sequence} exposures.") from None
+                yield FrameSet(sequence, images, meta_data, infos)
+        except threading.BrokenBarrierError:
+            # Another camera failed, raise what it failed with instead, once all have stopped.
+            for acquisition in acquisitions.values():
+                acquisition.stop()
+            for acquisition in acquisitions.values():
+                if acquisition.error is not None and not isinstance(acquisition.error, threading.BrokenBarrierError):
+                    raise acquisition.error
+            raise
+        finally:
+            # Release the cameras still waiting on the others before stopping them.
+            barrier.abort()
+            for iterator in iterators.values():
+                iterator.close()
+
+    def take_exposures(self, exposure_time, num_exposures, camera_kwargs=None, **kwargs):
+        """ Take exposures on all cameras at once, see self.stream_exposures().
+
+        Returns
+        -------
+        list of FrameSet
+            A set per exposure.
+        """
+        return list(self.stream_exposures(exposure_time, num_exposures, camera_kwargs=camera_kwargs, **kwargs))
+
+    @staticmethod
+    def _synchronize(stream, barrier):
+        """ Wait for all cameras before taking each exposure, and timestamp each upon hand over. """
+        try:
+            sequence = 0
+            while True:
+                barrier.wait()
+                try:
+                    image, meta_data = next(stream)[:2]
+                except StopIteration:
+                    break
+                yield image, meta_data, FrameInfo(sequence, time.monotonic(), dropped=None)
+                sequence += 1
+        except BaseException:
+            # Don't leave the other cameras waiting on this one.
+            barrier.abort()
+            raise
+        finally:
+            stream.close()
+
+
+class StreamStatistics:
+    """ Throughput, latency & drops of a stream of frames, accumulated from the FrameInfo of each frame as it is
+    consumed.
+
+    Latency is the time from capture until consumption. Frames are counted as dropped when either the driver says so
+    (FrameInfo.dropped) or they are missing from the sequence, e.g., dropped by a BackgroundAcquisition. Rate &
+    latencies are only kept for the last `window` frames, such that memory use is bounded for long streams.
+
+    Parameters
+    ----------
+    window : int
+        Number of most recent frames to compute rate & latency percentiles over.
+    """
+
+    def __init__(self, window=1000):
+        self.num_frames = 0
+        self.missing_frames = 0
+        self.driver_dropped_frames = 0
+        # Sequences count from 0, such that frames missing before the first one consumed are counted too.
+        self._last_sequence = -1
+        self._timestamps = deque(maxlen=window)
+        self._latencies = deque(maxlen=window)
+
+    @property
+    def dropped_frames(self):
+        return self.missing_frames + self.driver_dropped_frames
+
+    def add(self, info, consumed_at=None):
+        """ Account for a consumed frame.
+
+        Parameters
+        ----------
+        info : FrameInfo
+            Of the consumed frame.
+        consumed_at : float, optional
+            time.monotonic() of consumption, defaults to now.
+        """
+        consumed_at = time.monotonic() if consumed_at is None else consumed_at
+        self.num_frames += 1
+        if info.sequence > self._last_sequence + 1:
+            self.missing_frames += info.sequence - self._last_sequence - 1
+        self._last_sequence = info.sequence
+        if info.dropped is not None:
+            self.driver_dropped_frames = info.dropped
+        self._timestamps.append(info.timestamp)
+        self._latencies.append(consumed_at - info.timestamp)
+
+    @property
+    def fps(self):
+        """ Capture rate over the window, NaN for less than two frames. """
+        if len(self._timestamps) < 2 or self._timestamps[-1] <= self._timestamps[0]:
+            return np.nan
+        return (len(self._timestamps) - 1) / (self._timestamps[-1] - self._timestamps[0])
+
+    def latency_percentiles(self, percentiles=(50, 95, 99)):
+        """ Latencies (seconds) at the given percentiles over the window, NaN if there are no frames. """
+        if not self._latencies:
+            return [np.nan] * len(percentiles)
+        return [float(latency) for latency in np.percentile(self._latencies, percentiles)]
+
+    def summary(self):
+        """ Dict of all statistics. """
+        p50, p95, p99 = self.latency_percentiles((50, 95, 99))
+        return {"frames": self.num_frames,
+                "fps": self.fps,
+                "latency_p50": p50,
+                "latency_p95": p95,
+                "latency_p99": p99,
+                "dropped_frames": self.dropped_frames}
+
+    def log(self, data_log, tag):
+        """ Log self.summary() as scalars, tagged "<tag>/<statistic>", to the given catkit.datalogging.DataLogger. """
+        for name, value in self.summary().items():
+            data_log.log_scalar(f"{tag}/{name}", value)
+
+
+class Reducer:
+    """ Accumulates a stream of frames in place, such that memory use is independent of the number of frames.
+
+    Accumulators are allocated (as float64) upon the first frame added.
+    """
+
+    def __init__(self):
+        self.count = 0
+
+    def add(self, image):
+        """ Accumulate a single frame. """
+        image = np.asarray(image)
+        if self.count == 0:
+            self._allocate(image.shape)
+        elif image.shape != self.shape:
+            raise ValueError(f"Expected frames of shape '{self.shape}' but got '{image.shape}'")
+        self.count += 1
+        self._add(image)
+
+    def result(self):
+        """ The reduction of all frames added thus far. """
+        if self.count == 0:
+            raise ValueError("No frames to reduce.")
+        return self._result()
+
+    def _allocate(self, shape):
+        self.shape = shape
+
+    def _add(self, image):
+        raise NotImplementedError()
+
+    def _result(self):
+        raise NotImplementedError()
+
+
+class SumReducer(Reducer):
+    """ Sum of the frames. """
+
+    def _allocate(self, shape):
+        super()._allocate(shape)
+        self.sum = np.zeros(shape, dtype=np.float64)
+
+    def _add(self, image):
+        np.add(self.sum, image, out=self.sum)
+
+    def _result(self):
+        return self.sum.copy()
+
+
+class MeanReducer(SumReducer):
+    """ Mean of the frames. """
+
+    def _result(self):
+        return self.sum / self.count
+
+
+class MeanVarianceReducer(Reducer):
+    """ Mean and (unbiased) variance of the frames, accumulated using Welford's algorithm.
+
+    The result is the tuple (mean, variance). The variance of a single frame is zero.
+    """
+
+    def _allocate(self, shape):
+        super()._allocate(shape)
+        self.mean = np.zeros(shape, dtype=np.float64)
+        self.m2 = np.zeros(shape, dtype=np.float64)
+        self._delta = np.empty(shape, dtype=np.float64)
+        self._scratch = np.empty(shape, dtype=np.float64)
+
+    def _add(self, image):
+        # delta = x - mean_(n-1); mean_n = mean_(n-1) + delta / n; M2_n = M2_(n-1) + delta * (x - mean_n).
+        np.subtract(image, self.mean, out=self._delta)
+        np.multiply(self._delta, 1 / self.count, out=self._scratch)
+        self.mean += self._scratch
+        np.subtract(image, self.mean, out=self._scratch)
+        self._scratch *= self._delta
+        self.m2 += self._scratch
+
+    def variance(self):
+        if self.count < 2:
+            return np.zeros(self.shape, dtype=np.float64)
+        return self.m2 / (self.count - 1)
+
+    def _result(self):
+        return self.mean.copy(), self.variance()
+
+
+class MedianApproxReducer(Reducer):
+    """ Streaming approximation of the per-pixel median of the frames.
+
+    The estimate is initialized to the exact median of the first few (num_warmup) frames, after which each frame moves
+    it towards itself by a stochastic approximation (Robbins-Monro) step of sqrt(pi/2) * sigma / n. Sigma is estimated
+    from the median absolute deviation, tracked the same way, such that outliers (e.g., cosmic rays) affect neither.
+    The estimate converges to the median as frames are added, it is however not the exact median of a finite number of
+    frames.
+    """
+
+    num_warmup = 5
+    # sqrt(pi/2) * sigma / MAD for Gaussian noise.
+    step_scale = np.sqrt(np.pi / 2) * 1.4826
+
+    def _allocate(self, shape):
+        super()._allocate(shape)
+        self.median = np.zeros(shape, dtype=np.float64)
+        self.mad = np.zeros(shape, dtype=np.float64)
+        self._warmup = np.empty((self.num_warmup,) + tuple(shape), dtype=np.float64)
+        self._deviation = np.empty(shape, dtype=np.float64)
+        self._step = np.empty(shape, dtype=np.float64)
+
+    def _add(self, image):
+        if self.count <= self.num_warmup:
+            self._warmup[self.count - 1] = image
+            if self.count == self.num_warmup:
+                self._initialize(self._warmup)
+            return
+
+        # |x - median|
+        np.subtract(image, self.median, out=self._deviation)
+        np.abs(self._deviation, out=self._deviation)
+        # mad += mad / n * sign(|x - median| - mad)
+        np.subtract(self._deviation, self.mad, out=self._step)
+        np.sign(self._step, out=self._step)
+        self._step *= self.mad
+        self._step *= 1 / self.count
+        # step = sqrt(pi/2) * sigma / n, from the MAD prior to this frame.
+        np.multiply(self.mad, self.step_scale / self.count, out=self._deviation)
+        self.mad += self._step
+        # median += step * sign(x - median)
+        np.subtract(image, self.median, out=self._step)
+        np.sign(self._step, out=self._step)
+        self._step *= self._deviation
+        self.median += self._step
+
+    def _initialize(self, frames):
+        np.median(frames, axis=0, out=self.median)
+        deviations = np.abs(frames - self.median)
+        np.median(deviations, axis=0, out=self.mad)
+        # Fall back to the mean deviation where most frames are equal (e.g., integer data), else the median is stuck.
+        stuck = self.mad == 0
+        self.mad[stuck] = deviations.mean(axis=0)[stuck]
+
+    def _result(self):
+        if self.count < self.num_warmup:
+            return np.median(self._warmup[:self.count], axis=0)
+        return self.median.copy()
+
+
+reducers = {"sum": SumReducer,
+            "mean": MeanReducer,
+            "median-approx": MedianApproxReducer,
+            "mean+var": MeanVarianceReducer}
+
+
+def create_reducer(reduce):
+    """ Create the Reducer for the given reduction, one of catkit.acquisition.reducers. """
+    try:
+        return reducers[reduce]()
+    except KeyError:
+        raise ValueError(f"Expected reduce to be one of {list(reducers)} but got '{reduce}'") from None
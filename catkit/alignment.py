@@ -0,0 +1,208 @@
+"""Closed-loop alignment of a spot on a camera with picomotors."""
+
+from collections import namedtuple
+import logging
+
+import numpy as np
+
+from catkit import centroiding
+
+# The outcome of PicomotorAlignment.align().
+# converged is whether the spot ended within tolerance of the target, position its final (x, y) position (pixels),
+# error its distance (pixels) from the target, iterations the number of moves made and history the (x, y) positions
+# measured, starting with that before the first move.
+AlignmentResult = namedtuple("AlignmentResult", ["converged", "position", "error", "iterations", "history"])
+
+
+def calibration_matrix(calibration, axes):
+    """ Response matrix from the calibration of NewportPicomotorController.convert_move_to_pixel().
+
+    That calibration only determines the direction of moves up to their sign, so a matrix from it should be refined
+    online (see PicomotorAlignment.update()) or replaced by PicomotorAlignment.calibrate().
+
+    Parameters
+    ----------
+    calibration : dict
+        NewportPicomotorController.calibration, holding "r_ratio_<axis>" & "delta_theta_<axis>" for each of axes.
+    axes : tuple of int
+        Picomotor axes, in the order of the columns of the matrix.
+
+    Returns
+    -------
+    numpy.ndarray
+        2 x len(axes) matrix of the (x, y) pixels moved per step of each axis.
+    """
+    columns = []
+    for axis in axes:
+        theta = calibration[f"delta_theta_{axis}"] + (0 if axis in (1, 3) else np.pi / 2)
+        columns.append(calibration[f"r_ratio_{axis}"] * np.array([np.cos(theta), np.sin(theta)]))
+    return np.column_stack(columns)
+
+
+class PicomotorAlignment:
+    """ Drives a spot on a camera to a target pixel with picomotors.
+
+    The response of the spot's position to the picomotors is modelled as linear: a 2 x N matrix of the (x, y) pixels
+    moved per step of each of the N axes. Each iteration moves all axes at once, by the (least squares, minimum norm)
+    steps predicted to cancel the remaining offset from the target, and then refines the matrix from the move actually
+    observed. Hence, a stale matrix, e.g., after a thermal event, converges within a few iterations rather than needing
+    a full recalibration.
+
+    WARNING: The controller & camera must be open and not otherwise used whilst aligning.
+
+    Parameters
+    ----------
+    controller : catkit.hardware.newport.NewportPicomotorController.NewportPicomotorController
+        The picomotor controller.
+    camera : catkit.interfaces.Camera.Camera
+        The camera imaging the spot.
+    exposure_time : pint.Quantity or float
+        Exposure time, see camera.stream_exposures().
+    axes : tuple of int
+        Picomotor axes to align with, at least two that move the spot in different directions.
+    num_exposures : int
+        Number of exposures averaged (as they stream) per measurement of the spot's position.
+    centroid_method : str or callable
+        See catkit.centroiding.get_method().
+    centroid_roi_size : int, optional
+        If given, centroid within a region of interest of this size (pixels) around the last position, which must then
+        be large enough to contain the spot after a move.
+    matrix : numpy.ndarray, optional
+        Initial 2 x len(axes) response matrix (pixels per step), e.g., from a previous alignment or
+        calibration_matrix(). Defaults to measuring it, see self.calibrate().
+    camera_kwargs : dict, optional
+        Camera settings (ROI, gain etc) passed to camera.reduce_exposures().
+    """
+
+    def __init__(self, controller, camera, exposure_time, axes=(1, 2), num_exposures=1, centroid_method="windowed_com",
+                 centroid_roi_size=None, matrix=None, camera_kwargs=None):
+        self.log = logging.getLogger(f"{self.__module__}.{self.__class__.__qualname__}")
+        self.controller = controller
+        self.camera = camera
+        self.exposure_time = exposure_time
+        self.axes = tuple(axes)
+        self.num_exposures = num_exposures
+        self.centroid_method = centroiding.get_method(centroid_method)
+        self.centroid_roi_size = centroid_roi_size
+        self.camera_kwargs = {} if camera_kwargs is None else camera_kwargs
+        self.matrix = None if matrix is None else np.array(matrix, dtype=float)
+        if self.matrix is not None and self.matrix.shape != (2, len(self.axes)):
+            raise ValueError(f"Expected a response matrix of shape '{(2, len(self.axes))}' but got "
+                             f"'{self.matrix.shape}'")
+        # (x, y) of the last measured position.
+        self.position = None
+
+    def measure(self):
+        """ Measure the position of the spot.
+
+        Returns
+        -------
+        numpy.ndarray
+            (x, y) position in pixels.
+        """
+        image, _ = self.camera.reduce_exposures(self.exposure_time, self.num_exposures, reduce="mean",
+                                                **self.camera_kwargs)
+        center = self.position if self.centroid_roi_size else None
+        self.position = np.array(centroiding.centroid(image, self.centroid_method, center=center,
+                                                      size=self.centroid_roi_size), dtype=float)
+        return self.position
+
+    def calibrate(self, steps=100):
+        """ Measure the response matrix, moving each axis by `steps` and back, and store it in self.matrix. Also
+        updates the controller's calibration, see NewportPicomotorController.convert_move_to_pixel().
+
+        Parameters
+        ----------
+        steps : int
+            Steps to move each axis by, enough to move the spot by several pixels.
+
+        Returns
+        -------
+        numpy.ndarray
+            The 2 x len(axes) response matrix.
+        """
+        matrix = np.empty((2, len(self.axes)))
+        position = self.measure()
+        for i, axis in enumerate(self.axes):
+            self.controller.relative_move(axis, steps)
+            moved = self.measure() - position
+            self.controller.relative_move(axis, -steps)
+            position = self.measure()
+            matrix[:, i] = moved / steps
+
+            x_move, y_move = moved
+            self.controller.calibration[f"r_ratio_{axis}"] = np.hypot(x_move, y_move) / steps
+            self.controller.calibration[f"delta_theta_{axis}"] = np.arctan(y_move / x_move) - \
+                (0 if axis in (1, 3) else np.pi / 2)
+
+        self.matrix = matrix
+        self.log.info(f"Calibrated picomotor response (pixels per step) of axes {self.axes}: {matrix.tolist()}")
+        return matrix
+
+    def update(self, steps, moved):
+        """ Refine self.matrix from an observed move (Broyden's rank-one update), such that it predicts this move
+        exactly whilst keeping its prediction for orthogonal moves.
+
+        Parameters
+        ----------
+        steps : numpy.ndarray
+            Steps moved by each axis.
+        moved : numpy.ndarray
+            (x, y) pixels the spot moved by.
+        """
+        steps = np.asarray(steps, dtype=float)
+        self.matrix += np.outer(moved - self.matrix @ steps, steps) / (steps @ steps)
+
+    def align(self, target, tolerance=0.5, max_iterations=10, gain=1., max_step=None):
+        """ Drive the spot to a target pixel.
+
+        Parameters
+        ----------
+        target : tuple
+            (x, y) target position in pixels.
+        tolerance : float
+            Distance (pixels) from the target at which to stop.
+        max_iterations : int
+            Maximum number of moves.
+        gain : float
+            Fraction of the predicted steps to move by, lower to damp oscillations of a poor model.
+        max_step : int, optional
+            Maximum steps per axis per move, scaling all down alike. Defaults to the controller's max_step.
+
+        Returns
+        -------
+        AlignmentResult
+        """
+        if self.matrix is None:
+            self.calibrate()
+        max_step = self.controller.max_step if max_step is None else max_step
+        target = np.asarray(target, dtype=float)
+
+        position = self.measure()
+        history = [tuple(position)]
+        iterations = 0
+        while np.linalg.norm(target - position) > tolerance and iterations < max_iterations:
+            steps = gain * np.linalg.lstsq(self.matrix, target - position, rcond=None)[0]
+            largest = np.max(np.abs(steps))
+            if max_step and largest > max_step:
+                steps *= max_step / largest
+            steps = np.round(steps).astype(int)
+            if not steps.any():
+                self.log.warning(f"The remaining offset of {target - position} pixels is below a single step.")
+                break
+
+            # All axes at once, see NewportPicomotorController.move().
+            self.controller.move({axis: int(step) for axis, step in zip(self.axes, steps) if step})
+            iterations += 1
+
+            moved = self.measure() - position
+            self.update(steps, moved)
+            position = self.position
+            history.append(tuple(position))
+
+        error = float(np.linalg.norm(target - position))
+        converged = error <= tolerance
+        log = self.log.info if converged else self.log.warning
+        log(f"Alignment {'converged' if converged else 'did not converge'} to {error:.2f} pixels from {tuple(target)} "
+            f"after {iterations} moves.")
+        return AlignmentResult(converged, tuple(position), error, iterations, history)
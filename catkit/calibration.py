@@ -0,0 +1,92 @@
+"""Master dark & bias frames for cameras, see catkit.interfaces.Camera.take_master_calibration()."""
+
+from collections import namedtuple
+import logging
+import os
+
+from astropy.io import fits
+import numpy as np
+
+from catkit.catkit_types import MetaDataEntry
+import catkit.util
+
+# The camera settings a calibration frame is valid for.
+# exposure_time is in microseconds and None for biases. roi is a tuple describing the region of interest.
+CalibrationKey = namedtuple("CalibrationKey", ["config_id", "exposure_time", "gain", "bins", "roi"])
+
+
+class CalibrationCache:
+    """ Master dark & bias frames, keyed by the camera settings they were taken with, see CalibrationKey.
+
+    Masters are held in memory and, if a directory is given, persisted to (and loaded from) FITS files in it, such that
+    they outlive the camera connection.
+
+    Parameters
+    ----------
+    directory : str, optional
+        Where to persist masters to. Defaults to None, i.e., in memory only.
+    """
+
+    DARK = "dark"
+    BIAS = "bias"
+
+    def __init__(self, directory=None):
+        self.directory = directory
+        self.log = logging.getLogger(f"{self.__module__}.{self.__class__.__qualname__}")
+        self._masters = {}
+
+    def get(self, kind, key):
+        """ Get the master of the given kind ("dark" or "bias") for the given CalibrationKey, None if there's none. """
+        key = self._normalize(kind, key)
+        master = self._masters.get((kind, key))
+        if master is None and self.directory is not None:
+            filepath = self.filepath(kind, key)
+            if os.path.exists(filepath):
+                master = np.ascontiguousarray(fits.getdata(filepath), dtype=np.float32)
+                self._masters[(kind, key)] = master
+                self.log.info(f"Loaded master {kind} from '{filepath}'.")
+        return master
+
+    def put(self, kind, key, master, num_frames=None):
+        """ Store the master of the given kind ("dark" or "bias") for the given CalibrationKey. """
+        key = self._normalize(kind, key)
+        master = np.ascontiguousarray(master, dtype=np.float32)
+        self._masters[(kind, key)] = master
+
+        if self.directory is not None:
+            metadata = [MetaDataEntry("Calibration type", "CALTYPE", kind, "Master calibration frame type"),
+                        MetaDataEntry("Camera", "CAMERA", key.config_id, "Camera model, correlates to entry in ini"),
+                        MetaDataEntry("Exposure Time", "EXP_TIME", -1 if key.exposure_time is None else
+                                      key.exposure_time, "microseconds"),
+                        MetaDataEntry("Gain", "GAIN", key.gain, "Gain for camera"),
+                        MetaDataEntry("Bins", "BINS", key.bins, "Binning for camera"),
+                        MetaDataEntry("ROI", "ROI", self._roi_string(key.roi), "Region of interest")]
+            if num_frames is not None:
+                metadata.append(MetaDataEntry("Frames", "NFRAMES", num_frames, "Number of frames combined"))
+            if not os.path.exists(self.directory):
+                os.makedirs(self.directory)
+            catkit.util.write_fits(master, self.filepath(kind, key), metadata=metadata)
+        return master
+
+    def clear(self, kind=None):
+        """ Forget the masters (of the given kind) held in memory. Persisted masters are kept. """
+        for cached_kind, key in list(self._masters):
+            if kind is None or cached_kind == kind:
+                del self._masters[(cached_kind, key)]
+
+    def filepath(self, kind, key):
+        key = self._normalize(kind, key)
+        exposure_time = "" if key.exposure_time is None else f"_{key.exposure_time}us"
+        filename = f"master_{kind}_{key.config_id}{exposure_time}_gain{key.gain}_bins{key.bins}_" \
+                   f"{self._roi_string(key.roi)}.fits"
+        return os.path.join(self.directory, filename)
+
+    def _normalize(self, kind, key):
+        if kind not in (self.DARK, self.BIAS):
+            raise ValueError(f"Expected kind to be one of '{self.DARK}' or '{self.BIAS}' but got '{kind}'")
+        # Biases are independent of the exposure time.
+        return key._replace(exposure_time=None) if kind == self.BIAS else key
+
+    @staticmethod
+    def _roi_string(roi):
+        return "roi" + "_".join(str(value) for value in roi)
@@ -0,0 +1,196 @@
+"""Fast sub-pixel centroiding of spots, e.g., for alignment and picomotor calibration.
+
+All methods take a 2D image and return the (x, y) position of the spot in pixels, x along columns and y along rows,
+as photutils' centroid functions do. They only reduce over the image (rather than fitting), so cost a few passes over
+its pixels. Use centroid() to only centroid within a region of interest, e.g., around the previous position.
+"""
+
+import numpy as np
+
+
+def center_of_mass(image):
+    """ Intensity weighted mean position, from the projections of the image onto its axes.
+
+    Parameters
+    ----------
+    image : numpy.ndarray
+        2D image. Should be background subtracted, as any background pulls the result towards the image center.
+
+    Returns
+    -------
+    x, y : float
+        Position of the spot in pixels.
+    """
+    image = np.asarray(image)
+    columns = image.sum(axis=0, dtype=np.float64)
+    total = columns.sum()
+    if total == 0:
+        raise ValueError("Can't centroid an image with no signal.")
+    x = columns @ np.arange(image.shape[1]) / total
+    y = image.sum(axis=1, dtype=np.float64) @ np.arange(image.shape[0]) / total
+    return x, y
+
+
+def thresholded_center_of_mass(image, threshold=None, fraction=0.5):
+    """ Center of mass of only the signal above a threshold, which is subtracted, such that the background doesn't bias
+    the result.
+
+    Parameters
+    ----------
+    image : numpy.ndarray
+        2D image.
+    threshold : float, optional
+        Pixels below this are ignored. Defaults to `fraction` of the way from the minimum to the maximum of the image.
+    fraction : float
+        See `threshold`.
+
+    Returns
+    -------
+    x, y : float
+        Position of the spot in pixels.
+    """
+    image = np.asarray(image)
+    if threshold is None:
+        low, high = image.min(), image.max()
+        threshold = low + fraction * (float(high) - float(low))
+    weights = np.subtract(image, threshold, dtype=np.float32)
+    np.maximum(weights, 0, out=weights)
+    return center_of_mass(weights)
+
+
+def windowed_center_of_mass(image, center=None, size=16, iterations=5, tolerance=0.01, fraction=0.1):
+    """ Thresholded center of mass within a window, iteratively re-centered on the result, such that only the spot
+    (and not other sources or hot pixels in the image) contributes.
+
+    Parameters
+    ----------
+    image : numpy.ndarray
+        2D image.
+    center : tuple, optional
+        (x, y) to start from. Defaults to the brightest pixel.
+    size : int
+        Width & height of the window in pixels, should be a few times the spot's FWHM.
+    iterations : int
+        Maximum number of re-centerings.
+    tolerance : float
+        Stop once the window moved by less than this (pixels).
+    fraction : float
+        See thresholded_center_of_mass(), for the background within each window.
+
+    Returns
+    -------
+    x, y : float
+        Position of the spot in pixels.
+    """
+    image = np.asarray(image)
+    if center is None:
+        y, x = np.unravel_index(np.argmax(image), image.shape)
+    else:
+        x, y = center
+
+    for _ in range(iterations):
+        window, (x0, y0) = _window(image, (x, y), size)
+        x_window, y_window = thresholded_center_of_mass(window, fraction=fraction)
+        shift = np.hypot(x0 + x_window - x, y0 + y_window - y)
+        x, y = x0 + x_window, y0 + y_window
+        if shift < tolerance:
+            break
+    return x, y
+
+
+def quadratic_peak(image):
+    """ Position of the peak of a parabola through the brightest pixel and its neighbors, along each axis. The fastest
+    method, but only accurate to a fraction of a pixel & biased towards the brightest pixel's center for undersampled
+    spots.
+
+    Parameters
+    ----------
+    image : numpy.ndarray
+        2D image.
+
+    Returns
+    -------
+    x, y : float
+        Position of the spot in pixels.
+    """
+    image = np.asarray(image)
+    row, column = np.unravel_index(np.argmax(image), image.shape)
+    return (column + _parabola_vertex(image[row], column),
+            row + _parabola_vertex(image[:, column], row))
+
+
+def centroid(image, method=center_of_mass, center=None, size=None):
+    """ Centroid within a region of interest.
+
+    Parameters
+    ----------
+    image : numpy.ndarray
+        2D image.
+    method : str or callable
+        Method, see get_method().
+    center : tuple, optional
+        (x, y) center of the region of interest, e.g., the previous position of the spot. Defaults to the whole image.
+    size : int, optional
+        Width & height (pixels) of the region of interest, which is clipped to the image. Required with `center`.
+
+    Returns
+    -------
+    x, y : float
+        Position of the spot in pixels, within the whole image.
+    """
+    method = get_method(method)
+    if center is None:
+        return method(image)
+    if size is None:
+        raise ValueError("The size of the region of interest is required along with its center.")
+    window, (x0, y0) = _window(image, center, size)
+    x, y = method(window)
+    return x0 + x, y0 + y
+
+
+def get_method(method):
+    """ Look up a centroiding method by name.
+
+    Parameters
+    ----------
+    method : str or callable
+        "com", "thresholded_com", "windowed_com", "quadratic" (see this module), "1d" or "2d" (photutils'
+        centroid_1dg & centroid_2dg, which fit Gaussians and are much slower), or a callable taking an image and
+        returning (x, y), which is returned as is.
+
+    Returns
+    -------
+    callable
+    """
+    if callable(method):
+        return method
+    if method in ("1d", "2d"):
+        from photutils.centroids import centroid_1dg, centroid_2dg
+        return centroid_1dg if method == "1d" else centroid_2dg
+    if method not in methods:
+        raise NotImplementedError(f"Unknown centroid method '{method}', expected one of "
+                                  f"{sorted(methods) + ['1d', '2d']} or a callable.")
+    return methods[method]
+
+
+methods = {"com": center_of_mass,
+           "thresholded_com": thresholded_center_of_mass,
+           "windowed_com": windowed_center_of_mass,
+           "quadratic": quadratic_peak}
+
+
+def _window(image, center, size):
+    """ View of the size x size window of image around (x, y) center, clipped to the image, and its (x, y) origin. """
+    x, y = center
+    x0 = int(np.clip(round(x) - size // 2, 0, max(image.shape[1] - size, 0)))
+    y0 = int(np.clip(round(y) - size // 2, 0, max(image.shape[0] - size, 0)))
+    return image[y0:y0 + size, x0:x0 + size], (x0, y0)
+
+
+def _parabola_vertex(profile, index):
+    """ Offset from index of the vertex of the parabola through profile[index - 1:index + 2]. """
+    if index == 0 or index == len(profile) - 1:
+        return 0.
+    left, peak, right = (float(value) for value in profile[index - 1:index + 2])
+    curvature = left - 2 * peak + right
+    return 0. if curvature == 0 else 0.5 * (left - right) / curvature
@@ -0,0 +1,157 @@
+import collections
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+import threading
+import time
+from urllib.parse import parse_qsl, urlparse
+
+import numpy as np
+import requests
+
+from catkit.interfaces.Instrument import SimInstrument
+import catkit.hardware.sbig.SbigCamera
+
+
+class SbigResponse(requests.Response):
+    """ A requests.Response whose content can be streamed, as from a requests.Session.get(..., stream=True). """
+
+    def __init__(self, status_code=200, content=b""):
+        super().__init__()
+        self.status_code = status_code
+        self._content = content
+        self._content_consumed = True
+        self.encoding = "ascii"
+
+    def iter_content(self, chunk_size=1, decode_unicode=False):
+        view = memoryview(self._content)
+        for i in range(0, len(view), chunk_size):
+            yield bytes(view[i:i + chunk_size])
+
+
+class SbigEmulator:
+    """ Emulates the HTTP API of SBIG cameras, as a requests.Session would talk to it.
+
+    Exposures take their duration, then the readout takes readout_time (both in real time). Images are filled with the
+    exposure count, with the pixel at the origin set to 0 to check orientation. The last image is served until the next
+    exposure completes. Requests are counted by endpoint in
+    self.calls, and connections (i.e., sessions opened) in self.connections.
+    """
+
+    def __init__(self, config_id, readout_time=0.01, status_code=200):
+        self.config_id = config_id
+        self.readout_time = readout_time
+        self.status_code = status_code
+
+        self.settings = {"StartX": 0, "StartY": 0, "NumX": 0, "NumY": 0, "BinX": 1, "BinY": 1}
+        self.exposure_start = None
+        self.exposure_end = None
+        self.frame_count = 0
+        self.last_image_count = 0
+        self.calls = collections.Counter()
+        self.connections = 0
+
+    def Session(self):
+        self.connections += 1
+        return self
+
+    def close(self):
+        pass
+
+    def get(self, url, params=None, timeout=None, stream=False, **kwargs):
+        endpoint = urlparse(url).path.rsplit("/", 1)[-1]
+        self.calls[endpoint] += 1
+        if self.status_code != 200:
+            return SbigResponse(self.status_code)
+        return SbigResponse(content=getattr(self, endpoint.replace(".", "_"))(params or {}))
+
+    def state(self):
+        if self.exposure_start is None or time.monotonic() >= self.exposure_end + self.readout_time:
+            return catkit.hardware.sbig.SbigCamera.SbigCamera.IMAGER_STATE_IDLE
+        if time.monotonic() < self.exposure_end:
+            return catkit.hardware.sbig.SbigCamera.SbigCamera.IMAGER_STATE_EXPOSING
+        return catkit.hardware.sbig.SbigCamera.SbigCamera.IMAGER_STATE_READING_OUT
+
+    def ImagerState_cgi(self, params):
+        return str(self.state()).encode()
+
+    def ImagerSetSettings_cgi(self, params):
+        self.settings.update({key: int(value) for key, value in params.items() if key in self.settings})
+        return b""
+
+    def ImagerStartExposure_cgi(self, params):
+        if self.exposure_start is not None and self.state() == \
+                catkit.hardware.sbig.SbigCamera.SbigCamera.IMAGER_STATE_IDLE:
+            self.last_image_count = self.frame_count
+        self.frame_count += 1
+        self.exposure_start = time.monotonic()
+        self.exposure_end = self.exposure_start + float(params["Duration"])
+        return b""
+
+    def ImagerAbortExposure_cgi(self, params):
+        self.exposure_start = None
+        return b""
+
+    def ImagerImageReady_cgi(self, params):
+        ready = self.exposure_start is not None and \
+            self.state() == catkit.hardware.sbig.SbigCamera.SbigCamera.IMAGER_STATE_IDLE
+        return str(int(ready)).encode()
+
+    def ImagerData_bin(self, params):
+        shape = (self.settings["NumX"] // self.settings["BinX"], self.settings["NumY"] // self.settings["BinY"])
+        complete = self.state() == catkit.hardware.sbig.SbigCamera.SbigCamera.IMAGER_STATE_IDLE
+        image = np.full(shape, self.frame_count if complete else self.last_image_count, dtype=np.uint16)
+        image[0, 0] = 0
+        return image.tobytes()
+
+
+class SbigHTTPServer(ThreadingHTTPServer):
+    """ Serves an SbigEmulator over HTTP on localhost, such that the (non-simulated) SbigCamera can talk to it with
+    requests, e.g., for benchmarks. Use as a context manager, which serves from a background thread; the camera's
+    base_url is self.base_url. """
+
+    daemon_threads = True
+
+    class RequestHandler(BaseHTTPRequestHandler):
+        # Keep connections alive, as the camera does, see SbigCamera._open().
+        protocol_version = "HTTP/1.1"
+        # Headers & content are written separately, which would otherwise stall on delayed ACKs.
+        disable_nagle_algorithm = True
+
+        def do_GET(self):
+            with self.server.lock:
+                response = self.server.emulator.get(self.path, params=dict(parse_qsl(urlparse(self.path).query)))
+            self.send_response(response.status_code)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(len(response.content)))
+            self.end_headers()
+            self.wfile.write(response.content)
+
+        def log_message(self, format, *args):
+            pass
+
+    def __init__(self, emulator, port=0):
+        """
+        :param emulator: SbigEmulator to serve.
+        :param port: Port to listen on, by default any free one.
+        """
+        super().__init__(("127.0.0.1", port), self.RequestHandler)
+        self.emulator = emulator
+        self.lock = threading.Lock()
+        self.thread = None
+
+    @property
+    def base_url(self):
+        return f"http://127.0.0.1:{self.server_address[1]}/api/"
+
+    def __enter__(self):
+        self.thread = threading.Thread(target=self.serve_forever, daemon=True)
+        self.thread.start()
+        return self
+
+    def __exit__(self, exception_type, exception_value, exception_traceback):
+        self.shutdown()
+        self.thread.join()
+        self.server_close()
+
+
+class SbigCamera(SimInstrument, catkit.hardware.sbig.SbigCamera.SbigCamera):
+    instrument_lib = SbigEmulator
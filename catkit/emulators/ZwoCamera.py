@@ -1,9 +1,9 @@
-import abc
 import logging
 
 import zwoasi
 from catkit.config import CONFIG_INI
 
+from catkit.emulators.synthetic_images import SyntheticImageGenerator
 import catkit.hardware.zwo.ZwoCamera
 
 
@@ -12,10 +12,14 @@ ZwoASI = type("ZwoASI", (), zwoasi.__dict__)
 
 
 class ZwoEmulator(ZwoASI):
-    """ Class to emulate of the zwoasi library. """
+    """ Class to emulate of the zwoasi library. Captures synthetic images, see
+    catkit.emulators.synthetic_images.SyntheticImageGenerator, unless capture() is overridden. """
 
     implemented_camera_purposes = None
 
+    # Keyword arguments of the SyntheticImageGenerator, e.g., to set the sources or noise.
+    image_generator_kwargs = {}
+
     @classmethod
     def get_camera_mappings(cls):
         # Find all cameras
@@ -39,6 +43,9 @@ class ZwoEmulator(ZwoASI):
 
         self.camera_purpose = self.camera_mappings[self.config_id]["purpose"]
 
+        self.roi = {}
+        self.image_generator = None
+
     def init(self, library_file=None):
         pass
 
@@ -78,13 +85,22 @@ class ZwoEmulator(ZwoASI):
     def set_image_type(self, image_type):
         self.image_type = image_type
 
-    @abc.abstractmethod
     def capture(self, initial_sleep=0.01, poll=0.01, buffer=None, filename=None):
-        pass
+        # Exposures are instantaneous, such that the acquisition pipeline can be benchmarked.
+        if self.image_generator is None:
+            camera_property = self.get_camera_property()
+            self.image_generator = SyntheticImageGenerator(shape=(camera_property["MaxHeight"],
+                                                                  camera_property["MaxWidth"]),
+                                                           **self.image_generator_kwargs)
+        exposure_time = self.control_values.get(self.ASI_EXPOSURE, 0) / 1e6
+        return self.image_generator.generate(exposure_time, out=buffer, **self.roi)
 
     def capture_video_frame(self, buffer=None, filename=None, timeout=None):
         return self.capture(buffer=buffer, filename=filename)
 
+    def get_dropped_frames(self):
+        return 0
+
     def close(self):
         pass
 
@@ -108,5 +124,8 @@ class ZwoEmulator(ZwoASI):
         # runs zwolib.ASISetROIFormat(id_, width, height, bins, image_type)
         # set_roi_start_position --> _set_start_position :
         # runs zwolib.ASISetStartPos(id_, start_x, start_y)
-        pass  # according to Marshall
+        # The start position is in binned pixels.
+        bins = bins or 1
+        self.roi = {"start_x": (start_x or 0) * bins, "start_y": (start_y or 0) * bins, "width": width,
+                    "height": height, "bins": bins}
 
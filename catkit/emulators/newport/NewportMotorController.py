@@ -1,36 +1,98 @@
+import collections
+import itertools
 import logging
+import os
+import threading
+import time
 
 
-class NewportMotorControllerEmulator:
-    """ Emulates Newport's XPS driver specifically for their XPS Q8 motot controller. """
+# Trajectory files "uploaded" to the emulated controller by FtpEmulator, keyed by path.
+trajectory_files = {}
+
+
+class FtpEmulator:
+    """ Emulates the XPS' FTP server, as ftplib would talk to it, see NewportMotorController.upload_trajectory(). """
+
+    # The credentials of the last login.
+    credentials = None
+
+    @classmethod
+    def FTP(cls, host=None, user=None, passwd=None, *args, **kwargs):
+        cls.credentials = (user, passwd)
+        return cls()
 
     def __init__(self):
+        self.directory = "/"
+
+    def cwd(self, directory):
+        self.directory = directory
+
+    def storbinary(self, command, file, *args, **kwargs):
+        filename = command.split(" ", 1)[1]
+        trajectory_files[os.path.join(self.directory, filename)] = file.read().decode()
+
+    def quit(self):
+        pass
+
+
+class NewportMotorControllerEmulator:
+    """ Emulates Newport's XPS driver specifically for their XPS Q8 motot controller.
+
+    Moves & trajectories complete instantly unless velocity (units per second) is given, in which case they block for as
+    long as they would take (in real time), e.g., to emulate concurrent moves of several groups. Likewise, homing blocks
+    for home_search_time seconds. The number of those in progress at once is tracked in self.max_concurrent_moves, and
+    per socket (which the XPS driver doesn't support using from several threads at once) in
+    self.max_concurrent_socket_moves.
+
+    Groups start in initial_status (e.g., 0 for not initialized, as after a power cycle) and go through the XPS' state
+    machine: killed (7), initialized but not referenced (42) and ready (11).
+    """
+
+    trajectory_directory = "/Admin/Public/Trajectories"
+
+    def __init__(self, velocity=None, initial_status=11, home_search_time=0.):
         self.current_position = {}
+        self.velocity = velocity
+        self.initial_status = initial_status
+        self.home_search_time = home_search_time
+        self.status = {}
         self.log = logging.getLogger(__name__)
 
+        self.sockets = set()
+        self.max_concurrent_moves = 0
+        self.max_concurrent_socket_moves = 0
+        self.__socket_moves = collections.Counter()
+        self.__socket_ids = itertools.count()
+        self.__concurrent_moves = 0
+        self.__lock = threading.Lock()
+
     def XPS(self, *args, **kwargs):
         return self
 
     def TCP_ConnectToServer(self, host_ip, port, timeout, *args, **kwargs):
-        return self
+        socket_id = next(self.__socket_ids)
+        self.sockets.add(socket_id)
+        return socket_id
 
     def TCP_CloseSocket(self, socket_id, *args, **kwargs):
-        pass
+        self.sockets.discard(socket_id)
 
     def GroupMoveAbsolute(self, socket_id, positioner, position, *args, **kwargs):
         position = position[0]
+        self.__move(self.__duration(abs(position - self.current_position.get(positioner, 0.))), socket_id)
         self.current_position[positioner] = position
         self.sim_absolute_move(positioner, position)
         return 0, ""
 
     def GroupMoveRelative(self, socket_id, positioner, distance, *args, **kwargs):
         distance = distance[0]
+        self.__move(self.__duration(abs(distance)), socket_id)
         self.current_position[positioner] += distance
         self.sim_relative_move(positioner, distance)
         return 0, ""
 
     def GroupStatusGet(self, socket_id, group, *args, **kwargs):
-        return 0, 11
+        return 0, self.status.setdefault(group, self.initial_status)
 
     def GroupPositionCurrentGet(self, socket_id, positioner, *args, **kwargs):
         current_position = self.current_position.get(positioner)
@@ -40,12 +102,39 @@ class NewportMotorControllerEmulator:
         return 0, current_position
 
     def GroupKill(self, socket_id, group, *args, **kwargs):
+        self.status[group] = 7
         return 0, ""
 
     def GroupInitialize(self, socket_id, group, *args, **kwargs):
+        self.status[group] = 42
         return 0, ""
 
     def GroupHomeSearch(self, socket_id, group, *args, **kwargs):
+        self.__move(self.home_search_time, socket_id)
+        self.status[group] = 11
+        return 0, ""
+
+    def MultipleAxesPVTVerification(self, socket_id, group, filename, *args, **kwargs):
+        # -3: Wrong object type, i.e., the file doesn't exist.
+        return (0, "") if self.__trajectory_path(filename) in trajectory_files else (-3, "")
+
+    def MultipleAxesPVTExecution(self, socket_id, group, filename, execution_number, *args, **kwargs):
+        # Single axis groups only, i.e., "<time>, <displacement>, <velocity>" lines, positioner "<group>.Pos".
+        positioner = f"{group}.Pos"
+        for _ in range(execution_number):
+            for line in trajectory_files[self.__trajectory_path(filename)].splitlines():
+                duration, displacement, _ = (float(value) for value in line.split(","))
+                self.__move(self.__duration(duration=duration), socket_id)
+                self.current_position[positioner] = self.current_position.get(positioner, 0.) + displacement
+                self.sim_relative_move(positioner, displacement)
+        return 0, ""
+
+    def XYLineArcVerification(self, socket_id, group, filename, *args, **kwargs):
+        return (0, "") if self.__trajectory_path(filename) in trajectory_files else (-3, "")
+
+    def XYLineArcExecution(self, socket_id, group, filename, velocity, acceleration, execution_number, *args,
+                           **kwargs):
+        # Line-arc trajectories aren't emulated, positions are left as they are.
         return 0, ""
 
     def ErrorStringGet(self, socket_id, error_code, *args, **kwargs):
@@ -56,3 +145,28 @@ class NewportMotorControllerEmulator:
 
     def sim_absolute_move(self, positioner, position):
         """ Implement to make changes to the simulated system, e.g., a Poppy model. """
+
+    def __trajectory_path(self, filename):
+        return os.path.join(self.trajectory_directory, filename)
+
+    def __duration(self, distance=0., duration=None):
+        """ Seconds moving by distance (or for duration) takes, see self.velocity. """
+        if self.velocity is None:
+            return 0.
+        return distance / self.velocity if duration is None else duration
+
+    def __move(self, duration, socket_id):
+        """ Block for duration seconds, counting concurrent moves, in total and from socket_id. """
+        if not duration:
+            return
+        with self.__lock:
+            self.__concurrent_moves += 1
+            self.max_concurrent_moves = max(self.max_concurrent_moves, self.__concurrent_moves)
+            self.__socket_moves[socket_id] += 1
+            self.max_concurrent_socket_moves = max(self.max_concurrent_socket_moves, self.__socket_moves[socket_id])
+        try:
+            time.sleep(duration)
+        finally:
+            with self.__lock:
+                self.__concurrent_moves -= 1
+                self.__socket_moves[socket_id] -= 1
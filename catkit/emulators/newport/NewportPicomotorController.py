@@ -0,0 +1,102 @@
+import collections
+import re
+import time
+from urllib.parse import urlparse
+
+import requests
+
+from catkit.interfaces.Instrument import SimInstrument
+import catkit.hardware.newport.NewportPicomotorController
+
+
+class PicomotorResponse(requests.Response):
+
+    def __init__(self, status_code=200, text=""):
+        super().__init__()
+        self.status_code = status_code
+        self._content = text.encode()
+        self.encoding = "ascii"
+
+
+class NewportPicomotorEmulator:
+    """ Emulates the web interface of Newport's 8742 picomotor controller, as a requests.Session would talk to it.
+
+    Commands may be chained with semicolons, a response is only given for the last query. Motors move at velocity
+    (steps per second, in real time) towards their target, all at once. Requests are counted in self.requests and
+    commands by mnemonic in self.calls.
+    """
+
+    command_pattern = re.compile(r"^(?:(\d+)>)?(\d)?([A-Z]{2})(\?|-?\d+)?$")
+
+    def __init__(self, ip=None, velocity=2000, status_code=200):
+        self.ip = ip
+        self.velocity = velocity
+        self.status_code = status_code
+
+        # Per axis: (start position, target, start time, end time) of the last move.
+        self.moves = {axis: (0, 0, 0., 0.) for axis in range(1, 5)}
+        self.requests = 0
+        self.sessions = 0
+        self.calls = collections.Counter()
+
+    def Session(self):
+        self.sessions += 1
+        return self
+
+    def close(self):
+        pass
+
+    def position(self, axis):
+        start, target, start_time, end_time = self.moves[axis]
+        if time.monotonic() >= end_time:
+            return target
+        return start + (target - start) * (time.monotonic() - start_time) / (end_time - start_time)
+
+    def target(self, axis):
+        return self.moves[axis][1]
+
+    def is_moving(self, axis):
+        return time.monotonic() < self.moves[axis][3]
+
+    def move_to(self, axis, target):
+        start = round(self.position(axis))
+        start_time = time.monotonic()
+        self.moves[axis] = (start, target, start_time, start_time + abs(target - start) / self.velocity)
+
+    def get(self, url, params=None, timeout=None, **kwargs):
+        self.requests += 1
+        if self.status_code != 200:
+            return PicomotorResponse(self.status_code)
+        if urlparse(url).path.strip("/") != "cmd_send.cgi":
+            return PicomotorResponse(text="<html><body>Picomotor Controller</body></html>")
+
+        response = ""
+        for command in params["cmd"].split(";"):
+            daisy, axis, mnemonic, argument = self.command_pattern.match(command).groups()
+            axis = None if axis is None else int(axis)
+            self.calls[mnemonic] += 1
+            if argument == "?":
+                if mnemonic == "MD":
+                    response = str(int(not self.is_moving(axis)))
+                elif mnemonic in ("PA", "PR"):
+                    response = str(self.target(axis))
+                elif mnemonic == "TP":
+                    response = str(round(self.position(axis)))
+                elif mnemonic == "DH":
+                    response = "0"
+            elif mnemonic == "PA":
+                self.move_to(axis, int(argument))
+            elif mnemonic == "PR":
+                self.move_to(axis, self.target(axis) + int(argument))
+            elif mnemonic == "DH":
+                # Positions are relative to home, i.e., the current position becomes 0 (motors are assumed stopped).
+                self.moves[axis] = (0, 0, 0., 0.)
+            elif mnemonic == "RS":
+                self.moves = {axis: (0, 0, 0., 0.) for axis in range(1, 5)}
+
+        return PicomotorResponse(text=f"<html><body><!-- response -->{response}\r\n</body></html>")
+
+
+class NewportPicomotorController(SimInstrument,
+                                 catkit.hardware.newport.NewportPicomotorController.NewportPicomotorController):
+    instrument_lib = NewportPicomotorEmulator
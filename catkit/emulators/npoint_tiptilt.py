@@ -7,6 +7,7 @@ top.
 import logging
 import os
 import struct
+import time
 
 from catkit.hardware.npoint.nPointTipTiltController import Commands, Parameters, NPointLC400
 from catkit.interfaces.Instrument import SimInstrument
@@ -35,9 +36,12 @@ class PyvisaNpointEmulator:
 
     def initialize(self):
         self.value_store = {n: {var: 0 for var in Parameters} for n in NPointLC400.channels}
-        self.response_message = []
+        self.response_buffer = bytearray()
         self.address_cursor = None
         self.message = None  # Used only for introspection, debugging, & testing.
+        # (time, value) of each SETPOINT set, per channel, and the number of writes, e.g., to test streaming.
+        self.setpoint_history = {n: [] for n in NPointLC400.channels}
+        self.writes = 0
 
     def ResourceManager(self, *args, **kwargs):
         """ On hardware, locates device. In simulation, returns itself so we can keep going."""
@@ -51,12 +55,37 @@ class PyvisaNpointEmulator:
         self.initialize()
 
     def read_bytes(self, byte_count):
-        """ On hardware, reads single message from device. In simulation, pulls most recent message that expected a response. """
-        return self.response_message.pop()[:byte_count]
+        """ On hardware, reads bytes from device. In simulation, pulls them from the responses to messages that expected
+        one, in order. """
+        response = bytes(self.response_buffer[:byte_count])
+        del self.response_buffer[:byte_count]
+        return response
+
+    def read_memory(self, address, n_reads):
+        """ The n_reads consecutive 32b words from address, parameters being stored at their addresses and all else being
+        0. """
+        start = struct.unpack(NPointLC400.endian + 'I', address)[0]
+        memory = bytearray(n_reads * 4)
+        for channel, values in self.value_store.items():
+            for parameter, value in values.items():
+                offset = NPointLC400.int_address(parameter, channel) - start
+                if 0 <= offset and offset + parameter.data_length * 4 <= len(memory):
+                    struct.pack_into(NPointLC400.endian + parameter.data_type_fmt, memory, offset, value)
+        return bytes(memory)
 
     def write_raw(self, message):
-        """ On hardware, writes a single message from device. In simulation,
-        updates logical stored values. """
+        """ On hardware, writes message(s) to the device. In simulation, splits them into single messages (as
+        NPointLC400.stream_waveform() writes many at once) and updates logical stored values for each. """
+        self.writes += 1
+        start = 0
+        while start < len(message):
+            # SET & GET_ARRAY messages are 10B, SECOND_MSG & GET_SINGLE messages are 6B.
+            length = 10 if message[start:start + 1] in (Commands.SET.value, Commands.GET_ARRAY.value) else 6
+            self.write_message(message[start:start + length])
+            start += length
+
+    def write_message(self, message):
+        """ Update logical stored values, or construct a response, for a single message. """
         endian = NPointLC400.endian
 
         self.message = message
@@ -72,7 +101,12 @@ class PyvisaNpointEmulator:
 
         # Set value or construct response ready for next read.
         if command is Commands.SET:
+            if parameter.data_type_fmt == 'i':
+                # Messages are parsed as unsigned.
+                value = struct.unpack(endian + 'i', struct.pack(endian + 'I', value))[0]
             self.value_store[channel][parameter] = value
+            if parameter is Parameters.SETPOINT:
+                self.setpoint_history[channel].append((time.perf_counter(), value))
         elif command is Commands.SECOND_MSG:
             # If we wanted to emulator the hardware correctly, this would increment the address cursor and write the
             # value to that. However, it's easier and completely within the bounds of our current usage to just...
@@ -84,11 +118,14 @@ class PyvisaNpointEmulator:
             first_32b = struct.pack(endian + 'I', self.value_store[channel][parameter])
             second_32b = struct.pack(endian + 'I', value)
             self.value_store[channel][parameter] = struct.unpack(endian + 'd', first_32b + second_32b)[0]
-        elif command in (Commands.GET_SINGLE, Commands.GET_ARRAY):
+        elif command is Commands.GET_SINGLE:
             # Construct response message ready for it to be returned upon read.
             return_value = struct.pack(endian + parameter.data_type_fmt, self.value_store[channel][parameter])
-            self.response_message.append(b''.join([command.value, address, return_value, NPointLC400.endpoint]))
-            print("self.response_message", self.response_message)
+            self.response_buffer += b''.join([command.value, address, return_value, NPointLC400.endpoint])
+        elif command is Commands.GET_ARRAY:
+            # value is numReads, i.e., the number of consecutive 32b words to read from address.
+            self.response_buffer += b''.join([command.value, address, self.read_memory(address, value),
+                                              NPointLC400.endpoint])
         else:
             raise NotImplementedError(f'Non implemented command ({command}) found in message.')
 
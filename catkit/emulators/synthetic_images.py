@@ -0,0 +1,134 @@
+""" Synthetic camera images, for emulators and benchmarks of the acquisition pipeline. """
+
+import numpy as np
+from scipy.special import erf
+
+
+class SyntheticImageGenerator:
+    """
+    Generates detector images of a field of Gaussian PSFs: the expected signal (PSFs, dark current & hot pixels, in
+    electrons per second) is computed once per region of interest and cached, such that each frame only costs the noise
+    (Poisson shot noise & Gaussian read noise), the conversion to ADU (gain & bias) and the quantization to bit_depth.
+
+    Coordinates are those of the full (unbinned) detector, x along columns and y along rows.
+    """
+
+    def __init__(self, shape=(4096, 4096), sources=None, num_sources=25, fwhm=(2, 6), flux=(1e4, 1e6), sky=1,
+                 dark_current=0.01, hot_pixel_fraction=1e-4, hot_pixel_rate=(100, 1e4), read_noise=3, gain=1,
+                 bias=100, bit_depth=12, seed=None):
+        """
+        :param shape: (rows, columns) of the full detector.
+        :param sources: Optional array-like of (x, y, flux, fwhm) rows, flux in electrons per second and fwhm in pixels.
+                        Defaults to num_sources random sources.
+        :param num_sources: Number of sources when sources is None.
+        :param fwhm: (min, max) fwhm (pixels) of random sources.
+        :param flux: (min, max) flux (electrons per second) of random sources, drawn log-uniformly.
+        :param sky: Background (electrons per second per pixel).
+        :param dark_current: Dark current (electrons per second per pixel).
+        :param hot_pixel_fraction: Fraction of hot pixels, at random positions.
+        :param hot_pixel_rate: (min, max) dark current (electrons per second) of hot pixels, drawn log-uniformly.
+        :param read_noise: Read noise (electrons rms per pixel).
+        :param gain: Gain (electrons per ADU).
+        :param bias: Bias level (ADU).
+        :param bit_depth: Bit depth of the ADC, images are clipped to [0, 2**bit_depth - 1].
+        :param seed: Seed for the numpy.random.Generator of source positions and noise.
+        """
+        self.shape = tuple(shape)
+        self.rng = np.random.default_rng(seed)
+        self.sky = sky
+        self.dark_current = dark_current
+        self.read_noise = read_noise
+        self.gain = gain
+        self.bias = bias
+        self.max_value = 2**bit_depth - 1
+
+        if sources is None:
+            sources = np.column_stack((self.rng.uniform(0, self.shape[1], num_sources),
+                                       self.rng.uniform(0, self.shape[0], num_sources),
+                                       10**self.rng.uniform(*np.log10(flux), num_sources),
+                                       self.rng.uniform(*fwhm, num_sources)))
+        self.sources = np.atleast_2d(np.asarray(sources, dtype=np.float64))
+        if self.sources.shape[1] != 4:
+            raise ValueError(f"Expected sources of (x, y, flux, fwhm) rows but got shape '{self.sources.shape}'")
+
+        num_hot_pixels = int(round(hot_pixel_fraction * np.prod(self.shape)))
+        self.hot_pixels = (self.rng.integers(0, self.shape[0], num_hot_pixels),
+                           self.rng.integers(0, self.shape[1], num_hot_pixels),
+                           10**self.rng.uniform(*np.log10(hot_pixel_rate), num_hot_pixels))
+
+        # Signal (electrons per second), keyed by region of interest, and scratch buffers keyed by shape.
+        self._signal = {}
+        self._scratch = {}
+
+    def signal(self, start_x=0, start_y=0, width=None, height=None, bins=1):
+        """
+        The expected signal (electrons per second) within a region of interest, cached.
+        :param start_x: First (unbinned) column of the region.
+        :param start_y: First (unbinned) row of the region.
+        :param width: Width of the region in binned pixels, defaults to the rest of the detector.
+        :param height: Height of the region in binned pixels, defaults to the rest of the detector.
+        :param bins: Binning, each binned pixel collects the signal of bins x bins detector pixels.
+        :return: float32 numpy array of shape (height, width). Not to be modified.
+        """
+        width = (self.shape[1] - start_x) // bins if width is None else width
+        height = (self.shape[0] - start_y) // bins if height is None else height
+        key = (start_x, start_y, width, height, bins)
+        if key not in self._signal:
+            x, y, flux, fwhm = self.sources.T
+            sigma = fwhm / (2 * np.sqrt(2 * np.log(2)))
+
+            # The PSFs are separable, so the field is the product of their integrals over the (binned) pixel edges along
+            # y and x, summed over sources: (height, sources) @ (sources, width).
+            def integrals(start, size, center):
+                edges = start + bins * np.arange(size + 1) - 0.5
+                cdf = erf((edges[None, :] - center[:, None]) / (np.sqrt(2) * sigma[:, None]))
+                return 0.5 * np.diff(cdf, axis=1)
+
+            signal = (integrals(start_y, height, y) * flux[:, None]).T @ integrals(start_x, width, x)
+            signal += (self.sky + self.dark_current) * bins**2
+
+            rows, columns, rates = self.hot_pixels
+            rows = (rows - start_y) // bins
+            columns = (columns - start_x) // bins
+            inside = (rows >= 0) & (rows < height) & (columns >= 0) & (columns < width)
+            np.add.at(signal, (rows[inside], columns[inside]), rates[inside])
+
+            self._signal[key] = signal.astype(np.float32)
+        return self._signal[key]
+
+    def generate(self, exposure_time, out=None, start_x=0, start_y=0, width=None, height=None, bins=1):
+        """
+        Generate an image.
+        :param exposure_time: Exposure time (seconds).
+        :param out: Optional uint16 array (or buffer, e.g., a bytearray) of the region's size to fill.
+        :param start_x: See self.signal().
+        :param start_y: See self.signal().
+        :param width: See self.signal().
+        :param height: See self.signal().
+        :param bins: See self.signal().
+        :return: uint16 numpy array of shape (height, width), a view of out if given.
+        """
+        signal = self.signal(start_x=start_x, start_y=start_y, width=width, height=height, bins=bins)
+        if out is None:
+            out = np.empty(signal.shape, dtype=np.uint16)
+        elif not isinstance(out, np.ndarray):
+            out = np.frombuffer(out, dtype=np.uint16).reshape(signal.shape)
+        elif out.shape != signal.shape:
+            raise ValueError(f"Expected an output array of shape '{signal.shape}' but got '{out.shape}'")
+
+        if signal.shape not in self._scratch:
+            self._scratch[signal.shape] = (np.empty(signal.shape, dtype=np.float32),
+                                           np.empty(signal.shape, dtype=np.float32))
+        image, noise = self._scratch[signal.shape]
+
+        np.multiply(signal, exposure_time, out=image)
+        np.copyto(image, self.rng.poisson(image), casting="unsafe")
+        self.rng.standard_normal(dtype=np.float32, out=noise)
+        noise *= self.read_noise
+        image += noise
+        image *= 1 / self.gain
+        image += self.bias
+        np.rint(image, out=image)
+        np.clip(image, 0, self.max_value, out=image)
+        np.copyto(out, image, casting="unsafe")
+        return out
@@ -1,8 +1,11 @@
 import os
+import time
 
+import numpy as np
 import pytest
 
-from catkit.emulators.newport.NewportMotorController import NewportMotorControllerEmulator
+from catkit.emulators.newport.NewportMotorController import FtpEmulator, NewportMotorControllerEmulator, \
+    trajectory_files
 import catkit.hardware.newport.NewportMotorController
 from catkit.interfaces.Instrument import SimInstrument
 
@@ -18,6 +21,7 @@ config = load_config_ini(config_filename)
 
 class NewportMotorController(SimInstrument, catkit.hardware.newport.NewportMotorController.NewportMotorController):
     instrument_lib = NewportMotorControllerEmulator
+    ftp_lib = FtpEmulator
 
 
 @pytest.mark.usefixtures("dummy_config_ini")
@@ -29,6 +33,23 @@ def test_initialize_to_nominal():
             assert mc.get_position(motor_id) == CONFIG_INI.getfloat(motor_id, "nominal")
 
 
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_parallel_initialization():
+    from catkit.config import CONFIG_INI
+    groups = {CONFIG_INI.get(s, "group_name") for s in CONFIG_INI.sections() if s.startswith('motor_')}
+    start = time.perf_counter()
+    with NewportMotorController(config_id="dummy", host="dummy", port="dummy", initial_status=0,
+                                home_search_time=0.2) as mc:
+        # Homing each group takes 0.2s, all at once rather than one after another.
+        assert time.perf_counter() - start < 0.2 * len(groups) / 2
+        assert mc.instrument.max_concurrent_moves > 1
+        assert set(mc.instrument.status.values()) == {11}
+        assert set(mc.open_profile["groups"]) == groups
+        for timings in mc.open_profile["groups"].values():
+            assert timings["initialize"] >= 0.2
+        assert mc.open_profile["total"] >= max(timings["initialize"] for timings in mc.open_profile["groups"].values())
+
+
 @pytest.mark.usefixtures("dummy_config_ini")
 def test_abolute_move():
     with NewportMotorController(config_id="dummy", host="dummy", port="dummy") as mc:
@@ -46,3 +67,86 @@ def test_relative_move():
         position = mc.get_position(motor_id)
         mc.relative_move(motor_id, 2.)
         assert mc.get_position(motor_id) == position + 2.
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_move_together():
+    with NewportMotorController(config_id="dummy", host="dummy", port="dummy", initialize_to_nominal=False,
+                                velocity=10.) as mc:
+        positions = {"motor_FPM_X": 2., "motor_FPM_Y": 2., "motor_FPM_Z": 2.}
+        start = time.perf_counter()
+        mc.move_together(positions)
+        # Each group takes 0.2s, together rather than one after another.
+        assert time.perf_counter() - start < 0.5
+        assert mc.instrument.max_concurrent_moves == 3
+        for motor_id, position in positions.items():
+            assert mc.get_position(motor_id) == position
+
+        moves = mc.start_moves({"motor_FPM_X": 1., "motor_FPM_Y": -1.}, relative=True)
+        assert set(moves) == {"FPM_X", "FPM_Y"}
+        mc.wait_for_moves(moves)
+        assert mc.get_position("motor_FPM_X") == 3.
+        assert mc.get_position("motor_FPM_Y") == 1.
+
+        with pytest.raises(TimeoutError):
+            mc.wait_for_moves(mc.start_moves({"motor_FPM_X": 10.}), timeout=0.01)
+
+        # A socket per group, besides the main one.
+        assert len(mc.group_sockets) == 3
+        instrument = mc.instrument
+    assert not instrument.sockets
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_moves_of_a_group_are_serialized():
+    with NewportMotorController(config_id="newport_xps_q8", host="dummy", port="dummy", initialize_to_nominal=False,
+                                velocity=10.) as mc:
+        position = mc.get_position("motor_FPM_X")
+        first = mc.start_moves({"motor_FPM_X": 1.}, relative=True)
+        second = mc.start_moves({"motor_FPM_X": 1.}, relative=True)
+        mc.wait_for_moves(first)
+        mc.wait_for_moves(second)
+        # One after another, as they share the group's socket.
+        assert mc.instrument.max_concurrent_socket_moves == 1
+        assert mc.get_position("motor_FPM_X") == position + 2.
+
+        scan = mc.scan("motor_FPM_Y", np.linspace(1, 2, 3), np.full(2, 0.1), filename="scan.trj")
+        mc.move_together({"motor_FPM_Y": 0.})
+        mc.wait_for_moves(scan)
+        assert mc.instrument.max_concurrent_socket_moves == 1
+        assert mc.get_position("motor_FPM_Y") == 0.
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_not_open():
+    mc = NewportMotorController(config_id="dummy", host="dummy", port="dummy")
+    with pytest.raises(RuntimeError, match="not open"):
+        mc.start_moves({"motor_FPM_X": 1.})
+    with pytest.raises(RuntimeError, match="not open"):
+        mc.start_trajectory("FPM_X", "scan.trj")
+
+
+def test_pvt_trajectory():
+    content = NewportMotorController.pvt_trajectory([0., 1., 3., 3.], [1., 2., 1.])
+    lines = [[float(value) for value in line.split(",")] for line in content.splitlines()]
+    assert np.allclose(lines, [[1., 1., 1.], [2., 2., 0.5], [1., 0., 0.]])
+
+    with pytest.raises(ValueError):
+        NewportMotorController.pvt_trajectory([0., 1.], [1., 2.])
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_scan():
+    with NewportMotorController(config_id="newport_xps_q8", host="dummy", port="dummy",
+                                initialize_to_nominal=False) as mc:
+        positions = np.linspace(1, 2, 11)
+        scan = mc.scan("motor_FPM_X", positions, np.full(10, 0.1), filename="scan.trj")
+        assert "/Admin/Public/Trajectories/scan.trj" in trajectory_files
+        assert FtpEmulator.credentials == ("dummy_user", "dummy_password")
+        mc.wait_for_moves(scan)
+        assert np.isclose(mc.get_position("motor_FPM_X"), 2.)
+
+        with pytest.raises(Exception):
+            mc.wait_for_moves(mc.start_trajectory("FPM_X", "missing.trj"))
+        with pytest.raises(ValueError):
+            mc.start_trajectory("FPM_X", "scan.trj", line_arc=True)
@@ -0,0 +1,92 @@
+import pytest
+
+from catkit.emulators.newport.NewportPicomotorController import NewportPicomotorController
+import catkit.util
+
+
+@pytest.fixture()
+def picomotors(monkeypatch):
+    # Actually sleep, as the emulated motors move in real time.
+    monkeypatch.setattr(catkit.util, "simulation", False)
+    with NewportPicomotorController(config_id="picomotor", ip="127.0.0.1", max_step=1000, timeout=1, daisy=0) as device:
+        yield device
+
+
+def test_open(picomotors):
+    # All requests go through a single session, homing all axes at once.
+    assert picomotors.instrument.sessions == 1
+    assert picomotors.instrument.calls["DH"] == 4
+    assert picomotors.instrument.requests == 2
+
+
+def test_relative_move(picomotors):
+    picomotors.relative_move(1, 200)
+    picomotors.relative_move(1, -50)
+    assert picomotors.instrument.position(1) == 150
+    assert not picomotors.instrument.is_moving(1)
+
+    picomotors.absolute_move(2, -100)
+    assert picomotors.instrument.position(2) == -100
+
+
+def test_move(picomotors):
+    emulator = picomotors.instrument
+    requests = emulator.requests
+    picomotors.move({1: 200, 2: -100, 3: 50, 4: 0})
+
+    assert [emulator.position(axis) for axis in range(1, 5)] == [200, -100, 50, 0]
+    # A single request moved all axes, simultaneously.
+    assert emulator.calls["PR"] - 2 * 4 == 4
+    # Having slept for most of the longest move, rather than polling throughout, each axis is polled once or (the
+    # longest move) a few times.
+    assert 4 <= emulator.calls["MD"] <= 4 + 5
+    # Reading the initial & final positions of each axis, the moves and the polls.
+    assert emulator.requests - requests == 2 * 4 + 1 + emulator.calls["MD"]
+
+    picomotors.move({1: 0, 2: 0}, relative=False)
+    assert [emulator.position(axis) for axis in range(1, 5)] == [0, 0, 50, 0]
+
+
+def test_long_absolute_move(picomotors):
+    # Absolute moves wait for as long as the distance to move takes, rather than polling throughout.
+    picomotors.motion_timeout = 0.05
+    picomotors.relative_move(1, 800)
+    polls = picomotors.instrument.calls["MD"]
+    picomotors.absolute_move(1, -800)
+    assert picomotors.instrument.position(1) == -800
+    # Polling throughout the 0.8 s would take some 160 polls.
+    assert picomotors.instrument.calls["MD"] - polls < 40
+
+
+def test_reset_on_close(picomotors):
+    picomotors.move({1: 100, 3: -20})
+    picomotors._close()
+    assert [picomotors.instrument.position(axis) for axis in range(1, 5)] == [0, 0, 0, 0]
+
+
+def test_motion_timeout(picomotors):
+    picomotors.motion_timeout = 0.1
+    picomotors.instrument.velocity = 100
+    with pytest.raises(RuntimeError):
+        picomotors.relative_move(1, 1000)
+    # Such that resetting on close doesn't time out too.
+    picomotors.instrument.velocity = 1e6
+
+
+def test_max_step(picomotors):
+    with pytest.raises(ValueError):
+        picomotors.move({1: 10, 2: 1001})
+
+
+def test_http_error(picomotors):
+    picomotors.instrument.status_code = 500
+    with pytest.raises(Exception, match="Issues connecting"):
+        picomotors.move({1: 10})
+    picomotors.instrument.status_code = 200
+
+
+def test_connection_error():
+    device = NewportPicomotorController(config_id="picomotor", ip="127.0.0.1", max_step=1000, timeout=1, daisy=0,
+                                        status_code=404)
+    with pytest.raises(OSError):
+        device.__enter__()
@@ -2,9 +2,12 @@ import functools
 import itertools
 import os
 import struct
+import time
 
+import numpy as np
 import pytest
 
+import catkit.util
 from catkit.hardware.npoint.nPointTipTiltController import Commands, Parameters, NPointLC400
 from catkit.emulators.npoint_tiptilt import SimNPointLC400
 
@@ -51,10 +54,151 @@ def test_set_and_check(parameter, channel, value):
         controller.set(parameter, channel, value)
 
 
+def test_get_many():
+    with Controller() as controller:
+        controller.set(Parameters.LOOP, 1, 1)
+        controller.set(Parameters.P_GAIN, 1, 0.5)
+        controller.set(Parameters.D_GAIN, 2, -2.25)
+
+        parameters = list(itertools.product(Parameters, NPointLC400.channels))
+        values = controller.get_many(parameters)
+        assert values == {pair: controller.instrument_lib.value_store[pair[1]][pair[0]] for pair in parameters}
+        assert values[(Parameters.P_GAIN, 1)] == 0.5
+        assert values[(Parameters.D_GAIN, 2)] == -2.25
+
+        # A single GET_ARRAY, from the first parameter's address.
+        assert controller.instrument_lib.message[:1] == Commands.GET_ARRAY.value
+        assert controller.instrument_lib.message[1:5] == NPointLC400.build_address(Parameters.LOOP, 1)
+
+        assert controller.get_status(1) == {parameter: values[(parameter, 1)]
+                                            for parameter in NPointLC400.loop_parameters}
+
+
+def test_close_keeps_setpoint():
+    with Controller() as controller:
+        controller.set(Parameters.LOOP, 1, 1)
+        controller.set(Parameters.SETPOINT, 1, 100)
+        value_store = controller.instrument_lib.value_store
+    assert value_store[1][Parameters.LOOP] == 0
+    assert value_store[1][Parameters.SETPOINT] == 100
+
+
+def test_set_many():
+    values = {(parameter, channel): 0.25 * channel + i
+              for i, parameter in enumerate((Parameters.P_GAIN, Parameters.I_GAIN, Parameters.D_GAIN))
+              for channel in NPointLC400.channels}
+    values[(Parameters.LOOP, 1)] = 1
+    with Controller() as controller:
+        emulator = controller.instrument_lib
+        assert controller.set_many(values) == values
+        # A write of all SETs & a write of all GETs.
+        assert emulator.writes == 2
+        for (parameter, channel), value in values.items():
+            assert emulator.value_store[channel][parameter] == value
+
+        # Failures are all reported together.
+        emulator.writes = 0
+        original_write_message = emulator.write_message
+
+        def write_message(message):
+            original_write_message(message)
+            if message[:1] == Commands.SECOND_MSG.value:
+                channel, parameter = emulator.address_cursor
+                emulator.value_store[channel][parameter] = -1.
+        emulator.write_message = write_message
+        with pytest.raises(ValueError, match="for 6 parameters"):
+            controller.set_many(values)
+
+        # Responses out of sync with the requests.
+        emulator.write_message = original_write_message
+        emulator.response_buffer += b''.join([Commands.GET_SINGLE.value, NPointLC400.build_address(Parameters.LOOP, 2),
+                                              bytes(4), NPointLC400.endpoint])
+        with pytest.raises(RuntimeError):
+            controller.set_many({(Parameters.LOOP, 1): 1})
+        emulator.response_buffer.clear()
+
+        assert controller.set_many(values, verify=False) is None
+
+
 @pytest.mark.parametrize("value", (True, False))
 def test_set_closed_loop(value):
     with Controller() as controller:
         controller.set_closed_loop(value)
+        assert all(controller.instrument_lib.value_store[channel][Parameters.LOOP] == value
+                   for channel in NPointLC400.channels)
+
+
+@pytest.mark.parametrize("parameter", (Parameters.SETPOINT, Parameters.P_GAIN, Parameters.LOOP))
+def test_encode_waveform(parameter):
+    values = np.column_stack([np.arange(-2, 3), np.arange(5) * 2])
+    encoded = NPointLC400.encode_waveform(values, parameter=parameter)
+
+    # The same as setting each value in turn.
+    with Controller() as controller:
+        sent = []
+        controller._send = lambda message: sent.extend(message if isinstance(message, list) else [message])
+        for sample in values:
+            for channel, value in zip(NPointLC400.channels, sample):
+                controller.set(parameter, channel, int(value) if parameter is Parameters.SETPOINT else float(value))
+        assert encoded == b''.join(sent)
+
+    with pytest.raises(ValueError):
+        NPointLC400.encode_waveform(values, channels=(1,))
+
+
+class FakeClock:
+    """ A clock that only advances when slept on, and by tick seconds each time it's read, e.g., when spun on. """
+
+    def __init__(self, tick=1e-6):
+        self.now = 0.
+        self.tick = tick
+
+    def perf_counter(self):
+        self.now += self.tick
+        return self.now
+
+    def sleep(self, seconds):
+        self.now += seconds
+
+
+def test_stream_waveform(monkeypatch):
+    clock = FakeClock()
+    monkeypatch.setattr(time, "perf_counter", clock.perf_counter)
+    monkeypatch.setattr(catkit.util, "sleep", clock.sleep)
+    t = np.arange(40) / 100
+    values = np.column_stack([1000 * np.sin(2 * np.pi * 10 * t), 1000 * np.cos(2 * np.pi * 10 * t)])
+    with Controller() as controller:
+        report = controller.stream_waveform(values, rate=100, chunk_size=2)
+        emulator = controller.instrument_lib
+        assert emulator.writes == 20
+        for i, channel in enumerate(NPointLC400.channels):
+            times, setpoints = zip(*emulator.setpoint_history[channel])
+            assert np.array_equal(setpoints, np.round(values[:, i]))
+        # Chunks are written 20ms apart.
+        chunk_times = np.array(times[::2])
+        assert np.allclose(np.diff(chunk_times), 0.02, atol=1e-4)
+        assert report.samples == 40
+        assert report.rate == pytest.approx(100, rel=1e-3)
+        assert report.underruns == 0
+
+
+def test_stream_waveform_underruns(monkeypatch):
+    clock = FakeClock()
+    monkeypatch.setattr(time, "perf_counter", clock.perf_counter)
+    monkeypatch.setattr(catkit.util, "sleep", clock.sleep)
+    with Controller() as controller:
+        # Writing each chunk takes 3 sample periods, i.e., it falls ever further behind.
+        send = controller._send
+        monkeypatch.setattr(controller, "_send", lambda message: (send(message), clock.sleep(0.03)))
+        report = controller.stream_waveform(np.zeros((10, 2)), rate=100, chunk_size=1)
+        assert report.underruns == 9
+        assert report.max_lateness == pytest.approx(0.18, abs=1e-3)
+        # The last chunk was written 0.27s in, rather than 0.09s.
+        assert report.rate == pytest.approx(9 / 0.27, rel=1e-3)
+        assert report.duration == pytest.approx(0.3, rel=1e-3)
+
+        with pytest.raises(ValueError):
+            controller.stream_waveform(np.zeros((0, 2)), rate=100)
 
 
 @pytest.mark.parametrize(("command", "parameter", "channel", "value"),
@@ -0,0 +1,142 @@
+import os
+
+from astropy.io import fits
+import numpy as np
+import pytest
+from requests import HTTPError
+
+from catkit.catkit_types import quantity, units
+from catkit.config import CONFIG_INI
+from catkit.emulators.SbigCamera import SbigCamera, SbigEmulator, SbigHTTPServer
+import catkit.hardware.sbig.SbigCamera
+import catkit.util
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_take_exposures():
+    with SbigCamera(config_id="sbig_stx16803") as camera:
+        images = camera.take_exposures(exposure_time=quantity(0.01, units.second), num_exposures=3)
+        for i, image in enumerate(images):
+            assert image.shape == (128, 128)
+            assert image.dtype == np.float32
+            assert image[-1, -1] == i + 1
+            assert image[0, 0] == 0
+
+        # All requests went through a single session.
+        assert camera.instrument.connections == 1
+        assert camera.instrument.calls["ImagerStartExposure.cgi"] == 3
+        assert camera.instrument.calls["ImagerData.bin"] == 3
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_adaptive_polling(monkeypatch):
+    # Actually sleep.
+    monkeypatch.setattr(catkit.util, "simulation", False)
+    with SbigCamera(config_id="sbig_stx16803", readout_time=0.05) as camera:
+        exposure_time = quantity(0.1, units.second)
+        camera.take_exposures(exposure_time=exposure_time, num_exposures=1)
+        assert camera.readout_time == pytest.approx(0.05, abs=0.02)
+
+        # Once the readout time is known, exposures are slept through rather than polled.
+        polls = camera.instrument.calls["ImagerState.cgi"]
+        camera.take_exposures(exposure_time=exposure_time, num_exposures=3)
+        assert camera.instrument.calls["ImagerState.cgi"] - polls <= 3 * 5
+        # Sleeping past the end of the readout doesn't grow the estimate.
+        assert camera.readout_time == pytest.approx(0.05, abs=0.02)
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_stream_exposures_reuses_buffer():
+    with SbigCamera(config_id="sbig_stx16803") as camera:
+        buffers = set()
+        for i, (image, meta) in enumerate(camera.stream_exposures(exposure_time=1000, num_exposures=3, width=64,
+                                                                  height=64)):
+            assert image.shape == (64, 64)
+            assert image[-1, -1] == i + 1
+            buffers.add(id(camera.image_buffer))
+        assert len(buffers) == 1
+
+        # A change of ROI reallocates it.
+        image, meta = next(camera.stream_exposures(exposure_time=1000, num_exposures=1, width=128, height=128))
+        assert image.shape == (128, 128)
+        assert len(camera.image_buffer) == 128 * 128 * 2
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_http_error():
+    with pytest.raises(HTTPError):
+        with SbigCamera(config_id="sbig_stx16803", status_code=500):
+            pass
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_pipelined(monkeypatch, tmpdir):
+    monkeypatch.setattr(catkit.util, "simulation", False)
+    with SbigCamera(config_id="sbig_stx16803") as camera:
+        exposure_time = quantity(0.05, units.second)
+        images = camera.take_exposures(exposure_time=exposure_time, num_exposures=4, pipelined=True)
+        assert [image[-1, -1] for image in images] == [1, 2, 3, 4]
+        assert all(image[0, 0] == 0 for image in images)
+
+        paths = camera.take_exposures(exposure_time=exposure_time, num_exposures=3, pipelined=True, file_mode=True,
+                                      path=str(tmpdir), filename="dummy")
+        for i, path in enumerate(paths):
+            assert fits.getdata(path)[-1, -1] == i + 5
+            assert fits.getheader(path)["FRAME"] == i + 1
+
+        # Resuming only takes the missing exposures.
+        os.remove(paths[1])
+        paths = camera.take_exposures(exposure_time=exposure_time, num_exposures=3, pipelined=True, file_mode=True,
+                                      path=str(tmpdir), filename="dummy", resume=True)
+        assert fits.getdata(paths[1])[-1, -1] == 8
+        assert camera.instrument.frame_count == 8
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_pipelined_early_exit():
+    with SbigCamera(config_id="sbig_stx16803") as camera:
+        stream = camera.stream_exposures(exposure_time=1000, num_exposures=5, pipelined=True)
+        image, meta = next(stream)
+        assert image[-1, -1] == 1
+        stream.close()
+        assert camera.instrument.calls["ImagerAbortExposure.cgi"] == 1
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_full_image_software_binning():
+    with SbigCamera(config_id="sbig_stx16803") as camera:
+        image, meta = next(camera.stream_exposures(exposure_time=1000, num_exposures=1, full_image=True, bins=4))
+        assert image.shape == (1024, 1024)
+        assert image[-1, -1] == 4 * 4
+        assert image[0, 0] == 4 * 4 - 1
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_binning_is_reset():
+    # The camera keeps the binning of earlier exposures, which mustn't carry over.
+    with SbigCamera(config_id="sbig_stx16803") as camera:
+        image, meta = next(camera.stream_exposures(exposure_time=1000, num_exposures=1, width=128, height=128, bins=2))
+        assert image.shape == (64, 64)
+
+        image, meta = next(camera.stream_exposures(exposure_time=1000, num_exposures=1, full_image=True, bins=4))
+        assert camera.instrument.settings["BinX"] == camera.instrument.settings["BinY"] == 1
+        assert image.shape == (1024, 1024)
+
+        next(camera.stream_exposures(exposure_time=1000, num_exposures=1, width=128, height=128, bins=2))
+        image, meta = next(camera.stream_exposures(exposure_time=1000, num_exposures=1, width=128, height=128, bins=1))
+        assert camera.instrument.settings["BinX"] == camera.instrument.settings["BinY"] == 1
+        assert image.shape == (128, 128)
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_http_server(monkeypatch):
+    monkeypatch.setattr(catkit.util, "simulation", False)
+    emulator = SbigEmulator(config_id="sbig_stx16803", readout_time=0.001)
+    with SbigHTTPServer(emulator) as server:
+        CONFIG_INI.set("sbig_stx16803", "base_url", server.base_url)
+        with catkit.hardware.sbig.SbigCamera.SbigCamera(config_id="sbig_stx16803") as camera:
+            images = camera.take_exposures(exposure_time=quantity(0.001, units.second), num_exposures=3)
+            for i, image in enumerate(images):
+                assert image.shape == (128, 128)
+                assert image[-1, -1] == i + 1
+    assert emulator.calls["ImagerData.bin"] == 3
@@ -0,0 +1,98 @@
+from unittest import mock
+
+import astropy.units as u
+import numpy as np
+import pytest
+
+# The propagation model is checked against Poppy itself.
+poppy = pytest.importorskip("poppy", minversion="0.9")
+
+from catkit.hardware.iris_ao import segmented_dm_command  # noqa: E402
+from catkit.hardware.iris_ao.segmented_dm_command import SegmentedAperture, SegmentedDmCommand, calc_psfs  # noqa: E402
+
+DM_CONFIG_ID = "iris_ao"
+WAVELENGTH = 640 * u.nm
+
+
+def random_command(seed):
+    """ A command of random piston (um), tip & tilt (mrad) on all segments. """
+    command = SegmentedDmCommand(DM_CONFIG_ID)
+    rng = np.random.default_rng(seed)
+    ptt = rng.uniform(-0.1, 0.1, size=(command.aperture.number_segments_in_pupil, 3))
+    command.read_initial_command([tuple(values) for values in ptt])
+    return command
+
+
+def poppy_psf(command, rotation_angle, pixelscale=0.010, instrument_fov=1.0):
+    """ The PSF as computed by a poppy.OpticalSystem, i.e., prior to SegmentedDmPsfModel. """
+    command.update_aperture()
+    osys = poppy.OpticalSystem()
+    osys.add_pupil(command.aperture)
+    osys.add_detector(pixelscale=pixelscale, fov_arcsec=instrument_fov)
+    osys.add_rotation(angle=rotation_angle)
+    return osys.calc_psf(wavelength=WAVELENGTH)[0].data
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+@pytest.mark.parametrize("rotation_angle", (0, 30))
+def test_calc_psf_matches_poppy(rotation_angle):
+    command = random_command(seed=0)
+    psf = command.calc_psf(wavelength=WAVELENGTH, rotation_angle=rotation_angle)
+    expected = poppy_psf(command, rotation_angle)
+
+    assert psf.shape == expected.shape
+    # Same normalization...
+    assert psf.sum() == pytest.approx(expected.sum(), rel=1e-3)
+    # ...and the same PSF, rotated the same way.
+    assert np.abs(psf - expected).max() < 1e-3 * expected.max()
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+@pytest.mark.parametrize("batch_size", (1, 2, 5))
+def test_calc_psfs(batch_size):
+    commands = [random_command(seed) for seed in range(4)]
+    psfs = calc_psfs(commands, wavelength=WAVELENGTH, rotation_angle=30, batch_size=batch_size)
+
+    assert psfs.shape[0] == len(commands)
+    for command, psf in zip(commands, psfs):
+        assert np.allclose(psf, command.calc_psf(wavelength=WAVELENGTH, rotation_angle=30), rtol=1e-9, atol=1e-15)
+
+
+@pytest.mark.usefixtures("dummy_config_ini")
+def test_set_segments_skips_unchanged():
+    aperture = SegmentedAperture(DM_CONFIG_ID)
+    ptt = [(1e-8 * i, 1e-6, -1e-6) for i in range(len(aperture.segmentlist))]
+    set_actuator = poppy.dms.HexSegmentedDeformableMirror.set_actuator
+
+    with mock.patch.object(poppy.dms.HexSegmentedDeformableMirror, "set_actuator", autospec=True,
+                           side_effect=set_actuator) as spy:
+        aperture.set_segments(ptt)
+        assert spy.call_count == len(ptt)
+
+        # Nothing changed.
+        spy.reset_mock()
+        aperture.set_segments(ptt)
+        assert spy.call_count == 0
+
+        # Only the changed segment is set.
+        ptt[3] = (0, 0, 0)
+        aperture.set_segments(ptt)
+        assert [call.args[1] for call in spy.call_args_list] == [aperture.segmentlist[3]]
+
+        # A segment set directly is set again.
+        spy.reset_mock()
+        aperture.set_actuator(aperture.segmentlist[5], 0, 0, 0)
+        aperture.set_segments(ptt)
+        assert [call.args[1] for call in spy.call_args_list] == [aperture.segmentlist[5]] * 2
+
+        spy.reset_mock()
+        aperture.clear_applied_segments()
+        aperture.set_segments(ptt)
+        assert spy.call_count == len(ptt)
+
+    # The same surface as setting all segments anew.
+    expected = SegmentedAperture(DM_CONFIG_ID)
+    for seg, values in zip(expected.segmentlist, ptt):
+        expected.set_actuator(seg, *values)
+    wave = segmented_dm_command.poppy.Wavefront(wavelength=WAVELENGTH, npix=256, diam=aperture.pupil_diam)
+    assert np.array_equal(aperture.get_opd(wave), expected.get_opd(wave))
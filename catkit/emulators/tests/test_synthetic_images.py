@@ -0,0 +1,55 @@
+import numpy as np
+import pytest
+
+from catkit.emulators.synthetic_images import SyntheticImageGenerator
+
+
+def test_noise_statistics():
+    generator = SyntheticImageGenerator(shape=(256, 256), sources=np.empty((0, 4)), sky=0, dark_current=1000,
+                                        hot_pixel_fraction=0, read_noise=5, gain=2, bias=100, seed=0)
+    image = generator.generate(exposure_time=1).astype(np.float64)
+    assert image.mean() == pytest.approx(100 + 1000 / 2, rel=0.01)
+    # Shot & read noise add in quadrature, in electrons.
+    assert image.std() == pytest.approx(np.sqrt(1000 + 5**2) / 2, rel=0.05)
+
+
+def test_psf_flux_and_position():
+    sources = [(100.3, 60.7, 1e6, 4), (20, 200, 1e5, 2)]
+    generator = SyntheticImageGenerator(shape=(256, 256), sources=sources, sky=0, dark_current=0,
+                                        hot_pixel_fraction=0, seed=0)
+    signal = generator.signal()
+    assert signal.sum() == pytest.approx(1.1e6, rel=1e-4)
+    assert np.unravel_index(np.argmax(signal), signal.shape) == (61, 100)
+
+    # Binning conserves flux and regions of interest match the full frame.
+    assert generator.signal(bins=4).sum() == pytest.approx(signal.sum(), rel=1e-4)
+    roi = generator.signal(start_x=90, start_y=40, width=32, height=48)
+    assert np.allclose(roi, signal[40:88, 90:122], rtol=1e-4, atol=1e-3)
+
+
+def test_hot_pixels():
+    generator = SyntheticImageGenerator(shape=(128, 128), sources=np.empty((0, 4)), sky=0, dark_current=0,
+                                        hot_pixel_fraction=0.01, hot_pixel_rate=(1e3, 1e3), seed=0)
+    rows, columns, rates = generator.hot_pixels
+    assert len(rows) == round(0.01 * 128**2)
+    signal = generator.signal()
+    assert np.array_equal(signal > 0, np.isin(np.arange(128**2), rows * 128 + columns).reshape(128, 128))
+
+
+def test_fills_buffer_and_quantizes():
+    generator = SyntheticImageGenerator(shape=(64, 64), sources=[(32, 32, 1e9, 3)], bit_depth=12, seed=0)
+    buffer = bytearray(32 * 16 * 2)
+    image = generator.generate(1, out=buffer, start_x=16, start_y=24, width=32, height=16)
+    assert image.dtype == np.uint16
+    assert image.shape == (16, 32)
+    assert np.shares_memory(image, np.frombuffer(buffer, dtype=np.uint16))
+    assert image.max() == 2**12 - 1
+    assert image.min() >= 0
+
+    with pytest.raises(ValueError):
+        generator.generate(1, out=np.empty((8, 8), dtype=np.uint16), width=32, height=16)
+
+
+def test_reproducible():
+    images = [SyntheticImageGenerator(shape=(64, 64), seed=1).generate(0.1) for _ in range(2)]
+    assert np.array_equal(*images)
@@ -0,0 +1,410 @@
+import collections
+import os
+import threading
+import time
+
+from astropy.io import fits
+import numpy as np
+import pytest
+
+from catkit.acquisition import MultiCameraAcquisition
+from catkit.catkit_types import quantity, units
+from catkit.config import CONFIG_INI
+from catkit import datalogging
+import catkit.emulators.ZwoCamera
+import catkit.hardware.zwo.ZwoCamera
+from catkit.interfaces.Instrument import SimInstrument
+
+
+class ZwoEmulator(catkit.emulators.ZwoCamera.ZwoEmulator):
+    """ Returns frames filled with the frame count, captured into the given buffer as zwoasi does. """
+
+    implemented_camera_purposes = ("imaging_camera",)
+
+    def __init__(self, config_id):
+        super().__init__(config_id)
+        self.frame_count = 0
+        self.roi_shape = None
+        self.calls = collections.Counter()
+
+    def set_roi(self, start_x=None, start_y=None, width=None, height=None, bins=None, image_type=None):
+        self.calls["set_roi"] += 1
+        self.roi_shape = (height, width)
+
+    def set_control_value(self, control_type, value, auto=False):
+        self.calls["set_control_value"] += 1
+        return super().set_control_value(control_type, value, auto=auto)
+
+    def get_camera_property(self):
+        self.calls["get_camera_property"] += 1
+        return super().get_camera_property()
+
+    def capture(self, initial_sleep=0.01, poll=0.01, buffer=None, filename=None):
+        self.frame_count += 1
+        if buffer is None:
+            buffer = bytearray(int(np.prod(self.roi_shape)) * 2)
+        image = np.frombuffer(buffer, dtype=np.uint16).reshape(self.roi_shape)
+        image[...] = self.frame_count
+        image[0, 0] = 0  # Mark the origin to check orientation.
+        return image
+
+
+class ZwoCamera(SimInstrument, catkit.hardware.zwo.ZwoCamera.ZwoCamera):
+    instrument_lib = ZwoEmulator
+
+    @classmethod
+    def load_asi_lib(cls):
+        pass
+
+
+@pytest.fixture()
+def camera_config_id(dummy_config_ini):
+    return CONFIG_INI.get("testbed", "imaging_camera")
+
+
+class SyntheticZwoEmulator(catkit.emulators.ZwoCamera.ZwoEmulator):
+    implemented_camera_purposes = ("imaging_camera",)
+    image_generator_kwargs = {"seed": 0}
+
+
+class SyntheticZwoCamera(ZwoCamera):
+    instrument_lib = SyntheticZwoEmulator
+
+
+@pytest.mark.parametrize("use_video_capture_mode", (True, False))
+def test_synthetic_images(camera_config_id, use_video_capture_mode):
+    with SyntheticZwoCamera(config_id=camera_config_id) as camera:
+        images = [image for image, meta in camera.stream_exposures(exposure_time=1e5, num_exposures=3,
+                                                                   use_video_capture_mode=use_video_capture_mode)]
+        width = CONFIG_INI.getint(camera_config_id, "width")
+        height = CONFIG_INI.getint(camera_config_id, "height")
+        for image in images:
+            assert image.shape == (height, width)
+            assert image.min() >= 0
+        # Same field, different noise.
+        assert not np.array_equal(images[0], images[1])
+        assert np.mean(images[0]) == pytest.approx(np.mean(images[1]), rel=0.05)
+
+
+@pytest.mark.parametrize("use_video_capture_mode", (True, False))
+def test_stream_exposures(camera_config_id, use_video_capture_mode):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        images = [image for image, meta in camera.stream_exposures(exposure_time=100, num_exposures=6,
+                                                                   use_video_capture_mode=use_video_capture_mode)]
+        width = CONFIG_INI.getint(camera_config_id, "width")
+        height = CONFIG_INI.getint(camera_config_id, "height")
+        for i, image in enumerate(images):
+            assert image.shape == (height, width)
+            assert image.dtype == np.float32
+            assert image[-1, -1] == i + 1
+
+
+def test_video_frames_reuse_ring(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id, num_frame_buffers=2) as camera:
+        buffers = set()
+        for i, (frame, meta) in enumerate(camera.stream_exposures(exposure_time=100, num_exposures=6, raw_frames=True)):
+            with frame:
+                assert frame.data.dtype == np.uint16
+                assert frame.data[-1, -1] == i + 1
+                buffers.add(id(frame.buffer))
+        assert len(buffers) == 2
+        assert camera.frame_ring.num_free == 2
+
+
+def test_unreleased_frames_raise(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id, num_frame_buffers=2) as camera:
+        with pytest.raises(RuntimeError):
+            [frame for frame, meta in camera.stream_exposures(exposure_time=100, num_exposures=3, raw_frames=True)]
+
+
+def test_roi_change_reallocates_ring(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        for width in (64, 128):
+            images, meta = camera.just_take_exposures(exposure_time=100, num_exposures=2, width=width, height=width)
+            assert images[-1].shape == (width, width)
+            assert camera.frame_ring.shape == (width, width)
+
+
+@pytest.mark.parametrize("raw_frames", (True, False))
+def test_background_stream(camera_config_id, raw_frames):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        values = []
+        for frame, meta in camera.stream_exposures(exposure_time=100, num_exposures=20, raw_frames=raw_frames,
+                                                   background=True, queue_size=2):
+            if raw_frames:
+                with frame:
+                    values.append(frame.data[-1, -1])
+            else:
+                values.append(frame[-1, -1])
+        assert values == list(range(1, 21))
+        assert camera.dropped_frames == 0
+
+
+def test_background_stream_drop_oldest(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        stream = camera.stream_exposures(exposure_time=100, num_exposures=20, raw_frames=True,
+                                         background=True, queue_size=2, backpressure="drop_oldest")
+        first_frame, meta = next(stream)
+        # Hold on to the 1st frame until the producer has captured everything.
+        while camera.instrument.frame_count < 20:
+            time.sleep(0.01)
+        values = [first_frame.data[-1, -1]]
+        first_frame.release()
+        for frame, meta in stream:
+            with frame:
+                values.append(frame.data[-1, -1])
+
+        assert camera.dropped_frames == 20 - len(values)
+        assert camera.dropped_frames > 0
+        # The newest frames are kept.
+        assert values[-1] == 20
+        assert camera.frame_ring.num_free == camera.frame_ring.num_slots
+
+
+def test_background_stream_early_exit(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        stream = camera.stream_exposures(exposure_time=100, num_exposures=1000, raw_frames=True, background=True)
+        frame, meta = next(stream)
+        frame.release()
+        stream.close()
+        assert camera.instrument.frame_count < 1000
+        assert camera.frame_ring.num_free == camera.frame_ring.num_slots
+
+
+@pytest.mark.parametrize("use_video_capture_mode", (True, False))
+def test_reduce(camera_config_id, use_video_capture_mode):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        images, meta = camera.just_take_exposures(exposure_time=100, num_exposures=9,
+                                                  use_video_capture_mode=use_video_capture_mode)
+        images = np.array(images)
+        expected = {"sum": images.sum(axis=0),
+                    "mean": images.mean(axis=0),
+                    "mean+var": (images.mean(axis=0), images.var(axis=0, ddof=1))}
+        for reduce, expected_result in expected.items():
+            result = camera.take_exposures(exposure_time=100, num_exposures=9, reduce=reduce)
+            # The emulator keeps on counting frames.
+            offset = camera.instrument.frame_count - 9
+            if reduce == "mean+var":
+                assert np.allclose(result[0][images[0] != 0], expected_result[0][images[0] != 0] + offset)
+                assert np.allclose(result[1], expected_result[1])
+            else:
+                scale = 9 if reduce == "sum" else 1
+                assert np.allclose(result[images[0] != 0], expected_result[images[0] != 0] + offset * scale)
+                # Orientation is applied, i.e., the marked origin ends up where it does for individual images.
+                assert np.all(result[images[0] == 0] == 0)
+
+
+def test_reduce_file_mode(camera_config_id, tmpdir):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        mean = camera.take_exposures(exposure_time=100, num_exposures=4, reduce="mean", file_mode=True, raw_skip=1,
+                                     path=tmpdir, filename="dummy.fits")
+        assert mean[-1, -1] == 2.5
+        assert sorted(os.listdir(tmpdir)) == ["dummy_frame1.fits", "dummy_frame3.fits"]
+        assert fits.getdata(os.path.join(tmpdir, "dummy_frame3.fits"))[-1, -1] == 3
+
+
+def test_reduce_unknown(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        with pytest.raises(ValueError):
+            camera.take_exposures(exposure_time=100, num_exposures=2, reduce="mode")
+
+
+def test_file_mode(camera_config_id, tmpdir):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        images, meta = camera.take_exposures(exposure_time=100, num_exposures=3, file_mode=True, path=tmpdir,
+                                             filename="dummy", return_metadata=True)
+        for i, image in enumerate(images):
+            path = os.path.join(tmpdir, f"dummy_frame{i + 1}.fits")
+            assert np.array_equal(fits.getdata(path), image)
+            assert fits.getheader(path)["CAMERA"] == camera_config_id
+        assert [entry.name_8chars for entry in meta].count("PATH") == 1
+
+
+@pytest.mark.parametrize("reduce", (None, "mean"))
+def test_cube_mode(camera_config_id, reduce, tmpdir):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        start = time.time()
+        camera.take_exposures(exposure_time=100, num_exposures=4, file_mode=True, cube_mode=True, reduce=reduce,
+                              path=tmpdir, filename="dummy")
+        end = time.time()
+        assert os.listdir(tmpdir) == ["dummy.fits"]
+        with fits.open(os.path.join(tmpdir, "dummy.fits")) as hdu_list:
+            assert hdu_list[0].data.shape[0] == 4
+            assert np.array_equal(hdu_list[0].data[:, -1, -1], [1, 2, 3, 4])
+            assert hdu_list[0].header["CAMERA"] == camera_config_id
+            # The capture time of each frame, as seconds since the epoch.
+            timestamps = hdu_list["FRAMES"].data["TIMESTAMP"]
+            assert list(timestamps) == sorted(timestamps)
+            assert start - 0.1 <= timestamps[0] and timestamps[-1] <= end + 0.1
+
+
+def test_control_state_cache(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        camera.take_exposures(exposure_time=100, num_exposures=1)
+        calls = camera.instrument.calls.copy()
+        assert calls["set_roi"] == 1
+        assert calls["get_camera_property"] == 1
+
+        # Nothing changed, so nothing is sent.
+        camera.take_exposures(exposure_time=100, num_exposures=1)
+        assert camera.instrument.calls == calls
+
+        # Only the exposure time changed.
+        camera.take_exposures(exposure_time=200, num_exposures=1)
+        assert camera.instrument.calls - calls == collections.Counter(set_control_value=1)
+
+        calls = camera.instrument.calls.copy()
+        camera.take_exposures(exposure_time=200, num_exposures=1, width=64, height=64)
+        assert camera.instrument.calls - calls == collections.Counter(set_roi=1)
+
+        # Everything is applied afresh once invalidated.
+        calls = camera.instrument.calls.copy()
+        camera.invalidate_control_state()
+        camera.take_exposures(exposure_time=200, num_exposures=1, width=64, height=64)
+        assert camera.instrument.calls - calls == collections.Counter(set_control_value=2, set_roi=1,
+                                                                      get_camera_property=1)
+
+
+@pytest.mark.parametrize("use_video_capture_mode", (True, False))
+def test_dark_subtraction(camera_config_id, use_video_capture_mode, tmpdir):
+    with ZwoCamera(config_id=camera_config_id, calibration=str(tmpdir)) as camera:
+        with pytest.raises(LookupError):
+            camera.take_exposures(exposure_time=100, num_exposures=1, subtract="dark")
+
+        dark = camera.take_master_calibration("dark", exposure_time=100, num_exposures=4)
+        assert dark[-1, -1] == 2.5
+        images, meta = camera.just_take_exposures(exposure_time=100, num_exposures=2, subtract="dark",
+                                                  use_video_capture_mode=use_video_capture_mode)
+        assert [image[-1, -1] for image in images] == [5 - 2.5, 6 - 2.5]
+        assert images[0].dtype == np.float32
+
+        # Darks are specific to the settings.
+        with pytest.raises(LookupError):
+            camera.take_exposures(exposure_time=200, num_exposures=1, subtract="dark")
+        # Biases aren't specific to the exposure time.
+        camera.take_master_calibration("bias", exposure_time=32, num_exposures=1)
+        assert camera.take_exposures(exposure_time=200, num_exposures=1, subtract="bias")[0][-1, -1] == 9 - 8
+
+    # Masters persist.
+    with ZwoCamera(config_id=camera_config_id, calibration=str(tmpdir)) as camera:
+        assert np.array_equal(camera.get_master_calibration("dark", exposure_time=100), dark)
+        mean = camera.take_exposures(exposure_time=100, num_exposures=2, reduce="mean", subtract="dark")
+        assert mean[-1, -1] == 1.5 - 2.5
+
+
+class DataLogWriter:
+    def __init__(self):
+        self.events = collections.defaultdict(list)
+
+    def log(self, wall_time, tag, value, value_type):
+        self.events[tag].append(value)
+
+
+@pytest.fixture()
+def data_log_writer():
+    writer = DataLogWriter()
+    datalogging.DataLogger.add_writer(writer)
+    yield writer
+    datalogging.DataLogger.remove_writer(writer)
+
+
+@pytest.mark.parametrize("use_video_capture_mode", (True, False))
+def test_frame_info(camera_config_id, use_video_capture_mode, data_log_writer):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        infos = [info for image, meta, info in camera.stream_exposures(exposure_time=100, num_exposures=5,
+                                                                       use_video_capture_mode=use_video_capture_mode,
+                                                                       frame_info=True)]
+        assert [info.sequence for info in infos] == list(range(5))
+        assert all(later.timestamp >= earlier.timestamp for earlier, later in zip(infos, infos[1:]))
+        assert [info.dropped for info in infos] == [0 if use_video_capture_mode else None] * 5
+
+        assert camera.stream_statistics.num_frames == 5
+        assert camera.stream_statistics.dropped_frames == 0
+        assert data_log_writer.events[f"{camera_config_id}/stream/frames"] == [5]
+        assert len(data_log_writer.events[f"{camera_config_id}/stream/latency_p95"]) == 1
+
+
+def test_frame_info_background_drops(camera_config_id):
+    with ZwoCamera(config_id=camera_config_id) as camera:
+        stream = camera.stream_exposures(exposure_time=100, num_exposures=20, raw_frames=True, background=True,
+                                         queue_size=2, backpressure="drop_oldest")
+        first_frame, meta = next(stream)
+        while camera.instrument.frame_count < 20:
+            time.sleep(0.01)
+        sequences = [first_frame.info.sequence]
+        first_frame.release()
+        for frame, meta in stream:
+            with frame:
+                sequences.append(frame.info.sequence)
+
+        # Capture may run ahead of even the first frame being consumed, such that it isn't necessarily the 0th.
+        assert sequences == sorted(set(sequences)) and sequences[-1] == 19
+        assert camera.stream_statistics.missing_frames == camera.dropped_frames == 20 - len(sequences) > 0
+
+
+class MultiZwoEmulator(ZwoEmulator):
+    implemented_camera_purposes = ("imaging_camera", "pupil_camera")
+
+    # Across all cameras: The number of captures in progress, the most of those at once and the frame number of each
+    # capture in the order they started.
+    lock = threading.Lock()
+    concurrent_captures = 0
+    max_concurrent_captures = 0
+    started_captures = []
+
+    def capture(self, initial_sleep=0.01, poll=0.01, buffer=None, filename=None):
+        if self.fail_at == self.frame_count + 1:
+            raise self.ZWO_CaptureError("Emulated failure", exposure_status=2)
+        cls = MultiZwoEmulator
+        with cls.lock:
+            cls.concurrent_captures += 1
+            cls.max_concurrent_captures = max(cls.max_concurrent_captures, cls.concurrent_captures)
+            cls.started_captures.append(self.frame_count + 1)
+        try:
+            time.sleep(initial_sleep)
+        finally:
+            with cls.lock:
+                cls.concurrent_captures -= 1
+        return super().capture(initial_sleep=initial_sleep, poll=poll, buffer=buffer, filename=filename)
+
+
+class MultiZwoCamera(ZwoCamera):
+    instrument_lib = MultiZwoEmulator
+
+
+@pytest.fixture()
+def cameras(dummy_config_ini):
+    with MultiZwoCamera(config_id=CONFIG_INI.get("testbed", "imaging_camera")) as imaging_camera, \
+            MultiZwoCamera(config_id=CONFIG_INI.get("testbed", "pupil_camera")) as pupil_camera:
+        for camera in (imaging_camera, pupil_camera):
+            camera.instrument.fail_at = None
+        MultiZwoEmulator.max_concurrent_captures = 0
+        MultiZwoEmulator.started_captures = []
+        yield imaging_camera, pupil_camera
+
+
+def test_multi_camera_acquisition(cameras):
+    acquisition = MultiCameraAcquisition(cameras)
+    exposure_time = {camera.config_id: quantity(0.1, units.second) for camera in cameras}
+    frame_sets = acquisition.take_exposures(exposure_time, num_exposures=3, use_video_capture_mode=False,
+                                            camera_kwargs={cameras[1].config_id: dict(full_image=False, width=64, height=64)})
+    # The cameras expose at once, and in lockstep, i.e., neither starts its next exposure before both took the last.
+    assert MultiZwoEmulator.max_concurrent_captures == 2
+    assert MultiZwoEmulator.started_captures == [1, 1, 2, 2, 3, 3]
+    assert [frame_set.sequence for frame_set in frame_sets] == [0, 1, 2]
+    for i, frame_set in enumerate(frame_sets):
+        assert list(frame_set.images) == [camera.config_id for camera in cameras]
+        assert [image[-1, -1] for image in frame_set.images.values()] == [i + 1] * 2
+        assert set(info.sequence for info in frame_set.infos.values()) == {i}
+    assert frame_sets[0].images[cameras[1].config_id].shape == (64, 64)
+
+
+def test_multi_camera_acquisition_failure(cameras):
+    cameras[1].instrument.fail_at = 2
+    acquisition = MultiCameraAcquisition(cameras)
+    with pytest.raises(RuntimeError, match="Exposure status: 2"):
+        acquisition.take_exposures(100, num_exposures=5, use_video_capture_mode=False, full_image=False)
+    assert cameras[0].instrument.frame_count < 5
+
+    with pytest.raises(ValueError):
+        acquisition.take_exposures({cameras[0].config_id: 100}, num_exposures=1)
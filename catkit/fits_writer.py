@@ -0,0 +1,462 @@
+"""Writing FITS files fast, and in the background, such that acquisition doesn't wait on disk I/O."""
+
+import logging
+import math
+import os
+import queue
+import threading
+
+from astropy.io import fits
+import numpy as np
+
+from catkit.catkit_types import quantity
+
+# FITS files are made up of blocks of this many bytes.
+BLOCK_SIZE = 2880
+CARD_SIZE = 80
+
+# numpy dtype -> (BITPIX, BZERO), unsigned integers are stored signed and offset by BZERO, as per the FITS standard.
+BITPIX = {np.dtype(np.uint8): (8, None),
+          np.dtype(np.int16): (16, None),
+          np.dtype(np.uint16): (16, 2 ** 15),
+          np.dtype(np.int32): (32, None),
+          np.dtype(np.uint32): (32, 2 ** 31),
+          np.dtype(np.int64): (64, None),
+          np.dtype(np.float32): (-32, None),
+          np.dtype(np.float64): (-64, None)}
+
+# Keywords describing the data, set by the writers rather than taken from header templates.
+STRUCTURAL_KEYWORDS = ("SIMPLE", "BITPIX", "NAXIS", "NAXIS1", "NAXIS2", "NAXIS3", "EXTEND", "BZERO", "BSCALE",
+                       "PCOUNT", "GCOUNT", "END")
+
+# Data is byteswapped through a scratch buffer of (about) this many bytes at a time.
+WRITE_CHUNK_SIZE = 1024 ** 2
+
+
+def fsync_files(filepaths):
+    """ Flush the given files, and the directory entries of them, to disk. """
+    directories = set()
+    for filepath in filepaths:
+        # Windows requires write access to flush a file.
+        fd = os.open(filepath, os.O_RDWR if os.name == "nt" else os.O_RDONLY)
+        try:
+            os.fsync(fd)
+        finally:
+            os.close(fd)
+        directories.add(os.path.dirname(os.path.abspath(filepath)))
+
+    # Directories can't be opened as such on Windows.
+    if hasattr(os, "O_DIRECTORY"):
+        for directory in directories:
+            fd = os.open(directory, os.O_RDONLY | os.O_DIRECTORY)
+            try:
+                os.fsync(fd)
+            finally:
+                os.close(fd)
+
+
+def format_card(keyword, value, comment=None):
+    """ Format a FITS header card (keyword = value / comment), as astropy.io.fits.Card would.
+
+    :param keyword: str, truncated to 8 characters.
+    :param value: bool, int, float, str or None (undefined).
+    :param comment: str, optional, truncated to whatever fits on the card.
+    :return: str of CARD_SIZE characters, or a multiple thereof for strings continued over CONTINUE cards.
+    """
+    keyword = keyword.upper()[:8]
+
+    if value is None:
+        value_string = ""
+    elif isinstance(value, (bool, np.bool_)):
+        value_string = f"{'T' if value else 'F':>20}"
+    elif isinstance(value, (int, np.integer)):
+        value_string = f"{int(value):>20d}"
+    elif isinstance(value, (float, np.floating)):
+        value = float(value)
+        if not math.isfinite(value):
+            raise ValueError(f"FITS doesn't support the value '{value}' for '{keyword}'")
+        value_string = repr(value).upper()
+        if len(value_string) > 20:
+            value_string = f"{value:.16G}"
+        if "." not in value_string and "E" not in value_string:
+            value_string += ".0"
+        value_string = f"{value_string:>20}"
+    elif isinstance(value, str):
+        # Quotes are escaped by doubling them.
+        escaped = value.replace("'", "''")
+        if len(escaped) > CARD_SIZE - 12:
+            # Too long for a single card, leave the long string convention (CONTINUE cards) to astropy. These are rare
+            # enough not to matter for speed.
+            card = fits.Card(keyword, value, comment).image
+            if not card.isascii():
+                raise ValueError(f"FITS headers must be ASCII but got '{card}'")
+            return card
+        value_string = "'{:8s}'".format(escaped)
+        value_string = f"{value_string:20s}"
+    else:
+        raise TypeError(f"Unsupported FITS header value type '{type(value)}' for '{keyword}'")
+
+    card = f"{keyword:8s}= {value_string}"
+    if comment:
+        card += f" / {comment}"
+    card = f"{card[:CARD_SIZE]:{CARD_SIZE}s}"
+    if not card.isascii():
+        raise ValueError(f"FITS headers must be ASCII but got '{card}'")
+    return card
+
+
+def format_header(shape, dtype, metadata=None, header=None):
+    """ Format the header of a primary HDU, padded to a whole number of FITS blocks.
+
+    :param shape: Shape of the data.
+    :param dtype: numpy dtype of the data, one of BITPIX.
+    :param metadata: List of catkit.catkit_types.MetaDataEntry objects (or (keyword, value, comment) tuples).
+    :param header: astropy.io.fits.Header template. Structural keywords (NAXIS etc) are ignored.
+    :return: bytes
+    """
+    bitpix, bzero = BITPIX[np.dtype(dtype).newbyteorder("=")]
+
+    cards = [format_card("SIMPLE", True, "conforms to FITS standard"),
+             format_card("BITPIX", bitpix, "array data type"),
+             format_card("NAXIS", len(shape), "number of array dimensions")]
+    # NAXIS1 is the fastest varying axis, i.e., the last of numpy's (C ordered) shape.
+    cards.extend(format_card(f"NAXIS{i + 1}", length) for i, length in enumerate(reversed(shape)))
+    cards.append(format_card("EXTEND", True))
+    if bzero is not None:
+        cards.append(format_card("BZERO", bzero))
+        cards.append(format_card("BSCALE", 1))
+
+    # Later metadata entries of the same keyword override earlier ones, and the header template, as in an astropy
+    # Header.
+    metadata_cards = {}
+    for entry in metadata or []:
+        keyword, value, comment = (entry.name_8chars, entry.value, entry.comment) if hasattr(entry, "name_8chars") \
+            else entry
+        if isinstance(value, quantity):
+            value = value.magnitude
+        metadata_cards[keyword.upper()[:8]] = format_card(keyword, value, comment)
+
+    if header is not None:
+        cards.extend(card.image for card in header.cards
+                     if card.keyword not in STRUCTURAL_KEYWORDS and card.keyword not in metadata_cards)
+    cards.extend(metadata_cards.values())
+
+    cards.append(f"{'END':{CARD_SIZE}s}")
+    header_string = "".join(cards)
+    header_string += " " * (-len(header_string) % BLOCK_SIZE)
+    return header_string.encode("ascii")
+
+
+def write_raw_fits(data, filepath, metadata=None, header=None, memmap=False):
+    """ Write data as a primary HDU without going through astropy.io.fits, for speed with large images.
+
+    The header is formatted directly (see format_header()) and the data are byteswapped to big-endian through a small
+    scratch buffer, rather than as a whole copy. Data of dtypes not in BITPIX are written with astropy.io.fits instead.
+
+    :param data: numpy array.
+    :param filepath: Path of the file to write, which gets overwritten.
+    :param metadata: List of catkit.catkit_types.MetaDataEntry objects to add to the header.
+    :param header: astropy.io.fits.Header template.
+    :param memmap: If True, write the data through a numpy.memmap of the file instead.
+    :return: filepath
+    """
+    data = np.asarray(data)
+    dtype = data.dtype.newbyteorder("=")
+    if dtype not in BITPIX or data.ndim == 0:
+        hdu = fits.PrimaryHDU(data, header=header)
+        for entry in metadata or []:
+            value = entry.value.magnitude if isinstance(entry.value, quantity) else entry.value
+            hdu.header[entry.name_8chars[:8]] = (value, entry.comment)
+        hdu.writeto(filepath, overwrite=True)
+        return filepath
+
+    header_bytes = format_header(data.shape, dtype, metadata=metadata, header=header)
+    bzero = BITPIX[dtype][1]
+    big_endian = dtype.newbyteorder(">")
+    padding = -data.nbytes % BLOCK_SIZE
+
+    if memmap:
+        with open(filepath, "wb") as file:
+            file.write(header_bytes)
+            file.truncate(len(header_bytes) + data.nbytes + padding)
+        if data.size:
+            mapped = np.memmap(filepath, dtype=big_endian, mode="r+", offset=len(header_bytes), shape=data.shape)
+            mapped[...] = data
+            if bzero is not None:
+                mapped ^= dtype.type(bzero)
+            mapped.flush()
+            del mapped
+        return filepath
+
+    flat = np.ascontiguousarray(data).reshape(-1)
+    chunk_length = max(1, WRITE_CHUNK_SIZE // dtype.itemsize)
+    scratch = np.empty(min(chunk_length, flat.size), dtype=big_endian)
+    with open(filepath, "wb") as file:
+        file.write(header_bytes)
+        for start in range(0, flat.size, chunk_length):
+            chunk = flat[start:start + chunk_length]
+            swapped = scratch[:chunk.size]
+            # Byteswaps whilst copying.
+            np.copyto(swapped, chunk)
+            if bzero is not None:
+                # Subtracting BZERO (the sign bit) from unsigned data is a flip of the sign bit.
+                swapped ^= dtype.type(bzero)
+            file.write(swapped.data)
+        file.write(b"\0" * padding)
+    return filepath
+
+
+class FitsWriterPool:
+    """ Writes FITS files on background threads, one per disk (device) written to, each fed by a bounded queue.
+
+    write() returns as soon as the frame is queued and only blocks when the writer for its disk has fallen max_queued
+    frames behind, bounding memory use. Frames written to different disks are written in parallel. Errors raised
+    whilst writing are re-raised by the next call to write(), flush() or close().
+
+    NOTE: Data and headers are written as they are when their turn comes, so must not be modified once submitted.
+
+    Parameters
+    ----------
+    max_queued : int
+        Maximum number of frames queued per disk.
+    """
+
+    # Queue markers.
+    _FLUSH = object()
+    _STOP = object()
+
+    def __init__(self, max_queued=8):
+        if max_queued < 1:
+            raise ValueError(f"Expected max_queued >= 1 but got '{max_queued}'")
+        self.max_queued = max_queued
+        self.log = logging.getLogger(f"{self.__module__}.{self.__class__.__qualname__}")
+        self._workers = {}
+        self._lock = threading.Lock()
+        self._error = None
+        self._closed = False
+
+    def write(self, data, header, filepath):
+        """ Queue data to be written, as a primary HDU with the given header, to filepath (overwriting it). """
+        self._raise_error()
+        if self._closed:
+            raise RuntimeError("Writer pool is closed.")
+
+        directory = os.path.dirname(os.path.abspath(filepath))
+        if not os.path.exists(directory):
+            os.makedirs(directory)
+        self._get_worker(os.stat(directory).st_dev).queue.put((data, header, filepath))
+
+    def flush(self):
+        """ Block until everything queued thus far is written and synced to disk. """
+        workers = list(self._workers.values())
+        for worker in workers:
+            worker.queue.put(self._FLUSH)
+        for worker in workers:
+            worker.queue.join()
+        self._raise_error()
+
+    def close(self):
+        """ Flush and stop all writer threads. """
+        if self._closed:
+            return
+        try:
+            self.flush()
+        finally:
+            self._closed = True
+            for worker in self._workers.values():
+                worker.queue.put(self._STOP)
+            for worker in self._workers.values():
+                worker.thread.join()
+            self._workers.clear()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exception_type, exception_value, exception_traceback):
+        self.close()
+
+    def _get_worker(self, device):
+        with self._lock:
+            worker = self._workers.get(device)
+            if worker is None:
+                worker = _Worker(queue.Queue(self.max_queued))
+                worker.thread = threading.Thread(target=self._run, args=(worker,),
+                                                 name=f"{self.__class__.__qualname__}-{device}", daemon=True)
+                self._workers[device] = worker
+                worker.thread.start()
+            return worker
+
+    def _raise_error(self):
+        error = self._error
+        if error is not None:
+            self._error = None
+            raise error
+
+    def _run(self, worker):
+        unsynced = []
+        while True:
+            item = worker.queue.get()
+            try:
+                if item is self._STOP:
+                    return
+                elif item is self._FLUSH:
+                    fsync_files(unsynced)
+                    unsynced.clear()
+                else:
+                    data, header, filepath = item
+                    write_raw_fits(data, filepath, header=header)
+                    unsynced.append(filepath)
+                    self.log.info(f"'{filepath}' written to disk.")
+            except Exception as error:
+                self.log.exception("Failed to write FITS file.")
+                if self._error is None:
+                    self._error = error
+            finally:
+                worker.queue.task_done()
+
+
+class _Worker:
+    """ A writer thread and its queue. """
+
+    def __init__(self, queue):
+        self.queue = queue
+        self.thread = None
+
+
+class FitsCubeWriter:
+    """ Streams a sequence of frames into a single FITS file, as a 3D primary HDU, without buffering the stack.
+
+    The header is written upon the first frame, sized for num_frames (if known), after which each frame is appended
+    as is. Upon close(), NAXIS3 is rewritten in place to the number of frames actually appended, and a "FRAMES" binary
+    table extension holding the per-frame timestamps & metadata is appended.
+
+    Parameters
+    ----------
+    filepath : str
+        Path of the file to write, which gets overwritten.
+    header : astropy.io.fits.Header, optional
+        Header template, e.g., see catkit.util.build_fits_header(). Structural keywords (NAXIS etc) are ignored.
+    num_frames : int, optional
+        Expected number of frames, for the header written up front.
+    """
+
+    def __init__(self, filepath, header=None, num_frames=None):
+        self.filepath = filepath
+        self.header = fits.Header() if header is None else header
+        self.num_frames = num_frames
+        self.count = 0
+        self.shape = None
+        self.dtype = None
+
+        self._file = None
+        self._naxis3_offset = None
+        self._bzero = None
+        self._frame_meta = {"FRAME": [], "TIMESTAMP": []}
+        self._closed = False
+
+    def append(self, data, timestamp=None, meta=None, frame=None):
+        """ Append a frame.
+
+        :param data: Numpy data of the frame. All frames must be of the same shape and dtype.
+        :param timestamp: Time (seconds since the epoch) the frame was taken at. If unknown, the frame's TIMESTAMP is
+                          undefined (NaN).
+        :param frame: Frame number within the sequence of exposures, defaults to that within the cube (1 based), e.g.,
+                      differs when frames are skipped.
+        :param meta: Optional dict of scalar per-frame metadata, with the same keys for every frame, added as columns to
+                     the "FRAMES" table.
+        """
+        if self._closed:
+            raise RuntimeError(f"'{self.filepath}' is closed.")
+
+        data = np.asarray(data)
+        if self._file is None:
+            self._start(data.shape, data.dtype)
+        elif data.shape != self.shape or data.dtype != self.dtype:
+            raise ValueError(f"Expected frames of shape '{self.shape}' and dtype '{self.dtype}' "
+                             f"but got '{data.shape}' and '{data.dtype}'")
+
+        if self._bzero is not None:
+            # Subtracting BZERO (the sign bit) from unsigned data is a flip of the sign bit.
+            data = data ^ data.dtype.type(self._bzero)
+        self._file.write(data.astype(data.dtype.newbyteorder(">"), copy=False).tobytes())
+
+        self.count += 1
+        self._frame_meta["FRAME"].append(self.count if frame is None else frame)
+        self._frame_meta["TIMESTAMP"].append(np.nan if timestamp is None else timestamp)
+        for key, value in (meta or {}).items():
+            self._frame_meta.setdefault(key, []).append(value)
+
+    def close(self):
+        """ Finalize the file: fix up NAXIS3 for the number of frames appended and append the "FRAMES" table. """
+        if self._closed:
+            return
+        self._closed = True
+
+        if self._file is None:
+            # No frames, write just the header.
+            fits.PrimaryHDU(header=self._template()).writeto(self.filepath, overwrite=True)
+            return
+
+        try:
+            # Pad the data to a whole number of FITS blocks.
+            self._file.write(b"\0" * (-self._file.tell() % BLOCK_SIZE))
+            if self.count != self.num_frames:
+                self._file.seek(self._naxis3_offset)
+                self._file.write(fits.Card("NAXIS3", self.count).image.encode("ascii"))
+        finally:
+            self._file.close()
+
+        columns = {}
+        for key, values in self._frame_meta.items():
+            if len(values) != self.count:
+                raise ValueError(f"Per-frame metadata '{key}' is missing for some frames.")
+            columns[key] = np.asarray(values)
+        table = np.rec.fromarrays(list(columns.values()), names=list(columns))
+        fits.append(self.filepath, table, header=fits.Header([("EXTNAME", "FRAMES", "Per-frame metadata")]))
+
+        # Guarantee durability, as FitsWriterPool.flush() does.
+        fsync_files([self.filepath])
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exception_type, exception_value, exception_traceback):
+        self.close()
+
+    def _template(self):
+        header = fits.Header()
+        for card in self.header.cards:
+            if card.keyword not in STRUCTURAL_KEYWORDS:
+                header.append(card)
+        return header
+
+    def _start(self, shape, dtype):
+        if len(shape) != 2:
+            raise ValueError(f"Expected 2D frames but got shape '{shape}'")
+        dtype = np.dtype(dtype)
+        if dtype.newbyteorder("=") not in BITPIX:
+            raise TypeError(f"Unsupported dtype '{dtype}', expected one of {[str(key) for key in BITPIX]}")
+        bitpix, self._bzero = BITPIX[dtype.newbyteorder("=")]
+        self.shape = shape
+        self.dtype = dtype
+
+        header = fits.Header([("SIMPLE", True, "conforms to FITS standard"),
+                              ("BITPIX", bitpix, "array data type"),
+                              ("NAXIS", 3, "number of array dimensions"),
+                              ("NAXIS1", shape[1]),
+                              ("NAXIS2", shape[0]),
+                              ("NAXIS3", self.num_frames or 0),
+                              ("EXTEND", True)])
+        if self._bzero is not None:
+            header["BZERO"] = self._bzero
+            header["BSCALE"] = 1
+        header.extend(self._template())
+
+        directory = os.path.dirname(os.path.abspath(self.filepath))
+        if not os.path.exists(directory):
+            os.makedirs(directory)
+
+        header_string = header.tostring()
+        self._naxis3_offset = header_string.index(f"{'NAXIS3':8s}=")
+        self._file = open(self.filepath, "wb")
+        self._file.write(header_string.encode("ascii"))
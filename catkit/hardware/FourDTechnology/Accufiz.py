@@ -137,11 +137,11 @@ class Accufiz(FizeauInterferometer):
         image = np.clip(image0, -10, +10)[np.int(center[0]) - radiusmask:np.int(center[0]) + radiusmask - 1,
                 np.int(center[1]) - radiusmask: np.int(center[1]) + radiusmask - 1]
 
-        # Apply the rotation and flips.
-        image = catkit.util.rotate_and_flip_image(image, rotate, fliplr)
+        # Apply the rotation and flips, into a contiguous copy that can then be scaled in place.
+        image = catkit.util.orient_image(image, rotate, fliplr, dtype=np.result_type(image, np.float32))
 
         # Convert waves to nanometers.
-        image = image * wavelength
+        image *= wavelength
 
         fits_hdu = fits.PrimaryHDU(image)
         fits_hdu.writeto(fits_filepath, overwrite=True)
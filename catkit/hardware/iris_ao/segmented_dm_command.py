@@ -17,15 +17,21 @@ input Zernike coefficients.
 Additionally, a single segment can be changed using the SegmentedDmCommand.update_one_segment()
 method.
 
+PSFs are calculated with a cached propagation model per DM (see SegmentedDmPsfModel), such that
+repeated calls to command.display() or command.calc_psf() are fast, and calc_psfs() computes the
+PSFs of many commands in one go.
+
 """
 from configparser import NoOptionError
 import json
 import os
 
+from astropy.io import fits
 import astropy.units as u
 import matplotlib.pyplot as plt
 import numpy as np
 import poppy
+from scipy import ndimage
 
 from catkit.catkit_types import MetaDataEntry
 from catkit.config import CONFIG_INI
@@ -75,6 +81,9 @@ class SegmentedAperture(poppy.dms.HexSegmentedDeformableMirror):
         self._num_rings = self.get_number_of_rings_in_pupil()
         self._segment_list = self.get_segment_list()
 
+        # PTT values (Poppy units) last pushed to each segment, see set_segments().
+        self._applied_ptt = {}
+
         super().__init__(name='Segmented DM',
                          rings=self._num_rings,
                          flattoflat=self.flat_to_flat,
@@ -82,6 +91,34 @@ class SegmentedAperture(poppy.dms.HexSegmentedDeformableMirror):
                          segmentlist=self._segment_list,
                          rotation=self.rotation)
 
+    def set_segments(self, ptt_list):
+        """
+        Set piston, tip, tilt on every segment of the aperture, skipping those segments whose
+        values have not changed since they were last set through this method.
+
+        Setting a segment directly with set_actuator() is accounted for, but any other change to
+        the surface (e.g., Poppy's flatten()) must be followed by clear_applied_segments().
+
+        :param ptt_list: list of tuples of piston, tip, tilt values in Poppy units (m, rad, rad),
+                         ordered as self.segmentlist
+        """
+        for seg, values in zip(self.segmentlist, ptt_list):
+            values = tuple(values)
+            if self._applied_ptt.get(seg) != values:
+                self.set_actuator(seg, values[0], values[1], values[2])
+                self._applied_ptt[seg] = values
+
+    def set_actuator(self, segnum, piston, tip, tilt):
+        """
+        Set piston, tip, tilt on a single segment, as Poppy does, such that the next call to
+        set_segments() sets it again.
+        """
+        self._applied_ptt.pop(segnum, None)
+        super().set_actuator(segnum, piston, tip, tilt)
+
+    def clear_applied_segments(self):
+        """ Forget the values last set by set_segments(), such that it sets all segments again. """
+        self._applied_ptt.clear()
 
     def get_number_of_rings_in_pupil(self):
         """
@@ -184,6 +221,116 @@ class SegmentedAperture(poppy.dms.HexSegmentedDeformableMirror):
         return number_segments_in_pupil_per_ring[number_of_rings]
 
 
+class SegmentedDmPsfModel(object):
+    """
+    Cached monochromatic propagation from the segmented aperture to a detector, used to
+    quickly (re)compute the PSF of a segmented DM command.
+
+    Everything that depends only on the aperture geometry and the detector sampling, i.e., the
+    pupil transmission and the matrix Fourier transform (MFT) matrices, is computed once at
+    construction. Computing a PSF then only samples the current OPD of the aperture and applies
+    the two cached MFT matrices. This is the same propagation as done by a
+    poppy.OpticalSystem(pupil, detector, rotation), minus the per call setup cost.
+
+    Use get_psf_model() to share models between commands of the same DM.
+
+    :param aperture: SegmentedAperture object, the aperture to propagate from
+    :param wavelength: astropy quantity, wavelength to calculate the PSF at
+    :param pixelscale: float, detector pixel scale in arcsec/pixel
+    :param instrument_fov: float, detector field of view in arcsec
+    :param rotation_angle: float, rotation in degrees applied to the PSF in order to match the testbed
+    :param npix: int, number of pixels across the pupil
+    :param oversample: int, oversampling of the detector, as for a poppy.OpticalSystem
+    """
+
+    def __init__(self, aperture, wavelength=640*u.nm, pixelscale=0.010, instrument_fov=1.0, rotation_angle=0,
+                 npix=1024, oversample=2):
+        self.wavelength = wavelength.to(u.m).value
+        self.pixelscale = pixelscale
+        self.instrument_fov = instrument_fov
+        self.rotation_angle = rotation_angle
+        self.oversample = oversample
+
+        # Pupil plane sampling.
+        self.wave = poppy.Wavefront(wavelength=wavelength, npix=npix, diam=aperture.pupil_diam)
+        self.amplitude = np.sqrt(aperture.get_transmission(self.wave))
+        # Normalize such that the total intensity in the pupil is 1, as poppy does.
+        self.amplitude /= np.sqrt(np.sum(self.amplitude**2))
+        pupil_pixelscale = self.wave.pixelscale.to(u.m/u.pixel).value
+
+        # Detector plane sampling.
+        detector_pixelscale = (pixelscale / oversample * u.arcsec).to(u.radian).value
+        num_detector_pixels = int(np.round(instrument_fov / pixelscale)) * oversample
+
+        x_pupil = (np.arange(npix) - (npix - 1) / 2) * pupil_pixelscale
+        x_detector = (np.arange(num_detector_pixels) - (num_detector_pixels - 1) / 2) * detector_pixelscale
+
+        # MFT matrix, normalized such that energy is conserved, i.e., sum(psf) -> 1 for a large enough fov.
+        norm = np.sqrt(pupil_pixelscale * detector_pixelscale / self.wavelength)
+        self.mft_matrix = norm * np.exp(-2j * np.pi * np.outer(x_detector, x_pupil) / self.wavelength)
+        self.mft_matrix_t = np.ascontiguousarray(self.mft_matrix.T)
+
+    def get_opd(self, aperture):
+        """ Sample the current OPD (m) of the aperture on the cached pupil grid. """
+        return aperture.get_opd(self.wave)
+
+    def calc_psf_from_opd(self, opd):
+        """
+        Calculate the PSF(s) for one OPD map or a stack of OPD maps.
+
+        :param opd: np.array, OPD in meters of shape (npix, npix) or (n, npix, npix)
+        :return: np.array, normalized intensity of shape (ny, nx) or (n, ny, nx)
+        """
+        pupil_field = self.amplitude * np.exp((2j * np.pi / self.wavelength) * opd)
+        # Matmul broadcasts over the leading dimension of a stack.
+        detector_field = self.mft_matrix @ pupil_field @ self.mft_matrix_t
+
+        if self.rotation_angle:
+            # Rotate the field, rather than the intensity, as a poppy.Rotation does: its real and imaginary parts
+            # separately, in the plane of the last two axes in the same direction as ndimage.rotate()'s default.
+            axes = (-1, -2)
+            detector_field = ndimage.rotate(detector_field.real, self.rotation_angle, axes=axes, reshape=False) + \
+                1j * ndimage.rotate(detector_field.imag, self.rotation_angle, axes=axes, reshape=False)
+        return detector_field.real**2 + detector_field.imag**2
+
+    def calc_psf(self, aperture):
+        """ Calculate the PSF created by the current state of the aperture. """
+        return self.calc_psf_from_opd(self.get_opd(aperture))
+
+    def to_hdulist(self, psf):
+        """ Wrap a PSF in a fits.HDUList with the header keywords expected by poppy.display_psf(). """
+        hdu = fits.PrimaryHDU(psf)
+        hdu.header["WAVELEN"] = (self.wavelength, "Wavelength in meters")
+        hdu.header["PIXELSCL"] = (self.pixelscale / self.oversample, "Pixel scale in arcsec/pixel")
+        hdu.header["OVERSAMP"] = (self.oversample, "Oversampling factor of the detector")
+        hdu.header["ROTATION"] = (self.rotation_angle, "PSF rotation in degrees")
+        return fits.HDUList([hdu])
+
+
+# Cache of SegmentedDmPsfModel objects, see get_psf_model().
+_psf_models = {}
+
+
+def get_psf_model(aperture, wavelength=640*u.nm, pixelscale=0.010, instrument_fov=1.0, rotation_angle=0, **kwargs):
+    """
+    Get a cached SegmentedDmPsfModel for the aperture, creating it on the first call.
+
+    Models are keyed by the DM config section and rotation of the aperture such that all commands
+    for the same DM share a model, along with the detector parameters.
+
+    :param aperture: SegmentedAperture object
+    :return: SegmentedDmPsfModel object
+    """
+    key = (aperture.dm_config_id, aperture.rotation, wavelength.to(u.m).value, pixelscale, instrument_fov,
+           rotation_angle, tuple(sorted(kwargs.items())))
+    model = _psf_models.get(key)
+    if model is None:
+        model = SegmentedDmPsfModel(aperture, wavelength=wavelength, pixelscale=pixelscale,
+                                    instrument_fov=instrument_fov, rotation_angle=rotation_angle, **kwargs)
+        _psf_models[key] = model
+    return model
+
+
 class SegmentedDmCommand(object):
     """
     Handle segmented DM specific commands in terms of piston, tip and tilt (PTT) for
@@ -361,6 +508,41 @@ class SegmentedDmCommand(object):
                                           f"Piston/GradX/GradY applied for segment {seg}"))
         return metadata
 
+    def update_aperture(self):
+        """
+        Put the current data onto the Poppy model of the aperture, self.aperture. Only segments
+        whose values changed since the last update are pushed to the aperture.
+        """
+        # Grab the units of the DM for the piston, tip, tilt values and check that
+        #  they don't exceed the DM hardware limits
+        display_data = set_to_dm_limits(self.data)
+        # Convert the PTT list from DM to Poppy units
+        converted_list = convert_ptt_units(display_data, tip_factor=1, tilt_factor=-1,
+                                           starting_units=self.dm_command_units,
+                                           ending_units=(u.m, u.rad, u.rad))
+        # We want to round to four significant digits when in DM units (um, mrad, mrad).
+        # Here, we are in SI units (m, rad, rad), so we round to the equivalent, 10 decimals.
+        rounded_list = round_ptt_list(converted_list, decimals=10)
+        self.aperture.set_segments(rounded_list)
+
+    @poppy.utils.quantity_input(wavelength=u.nm)   # decorator provides a check on input units
+    def calc_psf(self, wavelength=640*u.nm, rotation_angle=0, pixelscale=0.010, instrument_fov=1.0):
+        """
+        Calculate the simulated PSF based on the mirror state, using a cached propagation model
+        (see get_psf_model()).
+
+        :param wavelength: Wavelength to calculate the PSF for
+        :param rotation_angle: float, the rotation to apply to the PSF image in order to match
+                               our testbed. Note that this value is specific to each testbed
+        :param pixelscale: pixel scale (arcsec/pixel) to calculate the PSF on
+        :param instrument_fov: instrument field of view (arcsec) to calculate the PSF on
+        :return: np.array, the normalized PSF
+        """
+        self.update_aperture()
+        model = get_psf_model(self.aperture, wavelength=wavelength, pixelscale=pixelscale,
+                              instrument_fov=instrument_fov, rotation_angle=rotation_angle)
+        return model.calc_psf(self.aperture)
+
     def display(self, display_wavefront=True, display_psf=True, psf_rotation_angle=0., vmax_opd=0.5e-6*u.meter, vmin_psf=1e-8, vmax_psf=1e-2,
                 save_figures=True, figure_name_prefix='', out_dir=''):
         """
@@ -377,18 +559,7 @@ class SegmentedDmCommand(object):
         :param save_figures: bool, If true, save out the figures in the directory specified
                              by out_dir
         """
-        # Grab the units of the DM for the piston, tip, tilt values and check that
-        #  they don't exceed the DM hardware limits
-        display_data = set_to_dm_limits(self.data)
-        # Convert the PTT list from DM to Poppy units
-        converted_list = convert_ptt_units(display_data, tip_factor=1, tilt_factor=-1,
-                                           starting_units=self.dm_command_units,
-                                           ending_units=(u.m, u.rad, u.rad))
-        # We want to round to four significant digits when in DM units (um, mrad, mrad).
-        # Here, we are in SI units (m, rad, rad), so we round to the equivalent, 10 decimals.
-        rounded_list = round_ptt_list(converted_list, decimals=10)
-        for seg, values in zip(self.aperture.segmentlist, rounded_list):
-            self.aperture.set_actuator(seg, values[0], values[1], values[2])
+        self.update_aperture()
 
         if figure_name_prefix:
             figure_name_prefix = f'{figure_name_prefix}_'
@@ -438,12 +609,9 @@ class SegmentedDmCommand(object):
         :param vmax: float, the maximum value to display in the plot
        """
         plt.figure()
-        osys = poppy.OpticalSystem()
-        osys.add_pupil(self.aperture)
-        osys.add_detector(pixelscale=pixelscale, fov_arcsec=instrument_fov)
-        osys.add_rotation(angle=rotation_angle)
-
-        psf = osys.calc_psf(wavelength=wavelength)
+        model = get_psf_model(self.aperture, wavelength=wavelength, pixelscale=pixelscale,
+                              instrument_fov=instrument_fov, rotation_angle=rotation_angle)
+        psf = model.to_hdulist(model.calc_psf(self.aperture))
         poppy.display_psf(psf, vmin=vmin, vmax=vmax,
                           title='PSF created by the shape put on the active segments')
         if save_figure:
@@ -452,6 +620,42 @@ class SegmentedDmCommand(object):
             plt.savefig(os.path.join(out_dir, f'{figure_name_prefix}simulated_psf.png'))
             plt.close()
 
+
+def calc_psfs(commands, wavelength=640*u.nm, rotation_angle=0, pixelscale=0.010, instrument_fov=1.0, batch_size=8):
+    """
+    Calculate the simulated PSFs for many segmented DM commands in one go.
+
+    All commands must be for the same DM such that they share a single cached propagation model
+    (see get_psf_model()). The OPD of each command is sampled and the propagation is then done
+    for batch_size commands at a time.
+
+    :param commands: list of SegmentedDmCommand objects
+    :param wavelength: Wavelength to calculate the PSFs for
+    :param rotation_angle: float, the rotation to apply to the PSF images in order to match
+                           our testbed
+    :param pixelscale: pixel scale (arcsec/pixel) to calculate the PSFs on
+    :param instrument_fov: instrument field of view (arcsec) to calculate the PSFs on
+    :param batch_size: int, number of PSFs to propagate at once; bounds the memory used
+    :return: np.array of shape (len(commands), ny, nx), the normalized PSFs
+    """
+    if not commands:
+        raise ValueError("No commands given.")
+
+    model = get_psf_model(commands[0].aperture, wavelength=wavelength, pixelscale=pixelscale,
+                          instrument_fov=instrument_fov, rotation_angle=rotation_angle)
+    psfs = []
+    for i in range(0, len(commands), batch_size):
+        opds = []
+        for command in commands[i:i + batch_size]:
+            if command.dm_config_id != commands[0].dm_config_id:
+                raise ValueError("All commands must be for the same DM.")
+            command.update_aperture()
+            opds.append(model.get_opd(command.aperture))
+        psfs.append(model.calc_psf_from_opd(np.asarray(opds)))
+
+    return np.concatenate(psfs)
+
+
 def load_command(segment_values, dm_config_id,
                  apply_flat_map=True, filename_flat=None):
     """
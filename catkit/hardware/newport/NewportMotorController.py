@@ -1,5 +1,11 @@
+from collections import defaultdict
+import concurrent.futures
+import ftplib
+import io
 import os
 import sys
+import threading
+import time
 
 import numpy as np
 
@@ -21,9 +27,14 @@ except Exception as error:
 class NewportMotorController(MotorController):
 
     instrument_lib = XPS_Q8_drivers
+    # Trajectory files are uploaded to the controller by FTP, see self.upload_trajectory().
+    ftp_lib = ftplib
 
     OK_STATES = (7, 11, 12, 42)
 
+    # Where the XPS reads trajectory files from.
+    trajectory_directory = "/Admin/Public/Trajectories"
+
     def __init__(self, *args, **kwargs):
         if isinstance(self.instrument_lib, BaseException):
             raise self.instrument_lib
@@ -38,7 +49,22 @@ class NewportMotorController(MotorController):
         self.initialize_to_nominal = initialize_to_nominal
         self.atol = atol
 
+        # Moves & trajectories started by self.start_moves() & self.start_trajectory() are issued from a socket per
+        # group (opened as needed), on worker threads, such that groups move concurrently. The XPS driver doesn't
+        # support using a socket from several threads at once, so work on each group is serialized by a lock per group.
+        self.group_sockets = {}
+        self.executor = None
+        self.__group_locks = {}
+        self.__group_sockets_lock = threading.Lock()
+
+        # Seconds spent opening the device: connecting, in total and per group, initializing (incl. homing) and
+        # moving to nominal, see self._open().
+        self.open_profile = {}
+
     def _open(self):
+        start = time.perf_counter()
+        self.open_profile = {"groups": {}}
+
         # Create an instance of the XPS controller.
         self.instrument = self.instrument_lib.XPS()
 
@@ -47,22 +73,39 @@ class NewportMotorController(MotorController):
         if socket_id == -1:
             raise Exception(f"Connection to XPS failed, check IP & Port (invalid socket '{socket_id}')")
         self.socket_id = socket_id
+        self.executor = concurrent.futures.ThreadPoolExecutor(thread_name_prefix=f"{self.config_id}-groups")
+        self.open_profile["connect"] = time.perf_counter() - start
 
-        # Initialize and move to nominal positions.
+        # Initialize (killing & homing as needed) and move to nominal positions, all groups at once such that this
+        # takes as long as the slowest group does.
         if self.initialize_to_nominal:
             self.log.info(f"Initializing Newport XPS Motor Controller {self.config_id}...")
-            motors = [s for s in CONFIG_INI.sections() if s.startswith('motor_')]
-            for motor_name in motors:
-                self.__move_to_nominal(motor_name)
+            moves = defaultdict(list)
+            for motor_id in [s for s in CONFIG_INI.sections() if s.startswith('motor_')]:
+                moves[CONFIG_INI.get(motor_id, "group_name")].append((CONFIG_INI.get(motor_id, "positioner_name"),
+                                                                      CONFIG_INI.getfloat(motor_id, "nominal")))
+            self.wait_for_moves({group: self.executor.submit(self.__open_group, group, group_moves)
+                                 for group, group_moves in moves.items()})
 
+        self.open_profile["total"] = time.perf_counter() - start
+        self.log.info(f"Opened Newport XPS Motor Controller {self.config_id} in {self.open_profile['total']:.2f}s "
+                      f"(per group: {self.open_profile['groups']})")
         return self.instrument
 
     def _close(self):
         """Close dm connection safely."""
         try:
-            self.instrument.TCP_CloseSocket(self.socket_id)
+            if self.executor is not None:
+                self.executor.shutdown(wait=True)
+            for socket_id in self.group_sockets.values():
+                self.instrument.TCP_CloseSocket(socket_id)
         finally:
-            self.socket_id = None
+            self.executor = None
+            self.group_sockets = {}
+            try:
+                self.instrument.TCP_CloseSocket(self.socket_id)
+            finally:
+                self.socket_id = None
 
     def absolute_move(self, motor_id, position):
         """
@@ -96,6 +139,128 @@ class NewportMotorController(MotorController):
         error_code, return_string = self.instrument.GroupMoveRelative(self.socket_id, positioner, [distance])
         self.__raise_on_error(error_code, 'GroupMoveRelative')
 
+    def start_moves(self, positions, relative=False):
+        """
+        Start moving several motors at once, without waiting for them to arrive. Motors of different groups move
+        concurrently, each group's moves being issued from its own socket on a worker thread, whereas motors of the same
+        group move one after another, after any moves (or trajectory) still running on the group. Absolute moves are skipped for motors already in position (or close enough).
+        :param positions: Dict of positions to move to (distances to move by if relative), keyed by motor_id (ex:
+                          motor_FPM_X).
+        :param relative: Whether to move by rather than to the given positions.
+        :return: Dict of concurrent.futures.Future of the moves of each group, keyed by group, see
+                 self.wait_for_moves().
+        """
+        moves = defaultdict(list)
+        for motor_id, position in positions.items():
+            moves[CONFIG_INI.get(motor_id, "group_name")].append((CONFIG_INI.get(motor_id, "positioner_name"),
+                                                                  position))
+
+        return {group: self.__submit(self.__move_group, group, group_moves, relative)
+                for group, group_moves in moves.items()}
+
+    def wait_for_moves(self, moves, timeout=None):
+        """
+        Wait for moves (or trajectories) started by self.start_moves() (or self.start_trajectory()) to complete.
+        :param moves: Dict of concurrent.futures.Future, keyed by group, as returned by self.start_moves().
+        :param timeout: Seconds to wait for, defaults to waiting until all complete.
+        :raises TimeoutError: If not all moves completed in time.
+        :raises Exception: The error of the first failed move, once all others completed.
+        """
+        done, not_done = concurrent.futures.wait(list(moves.values()), timeout=timeout)
+        if not_done:
+            pending = [group for group, move in moves.items() if move in not_done]
+            raise TimeoutError(f"Groups {pending} didn't complete their moves within {timeout} seconds.")
+        for move in moves.values():
+            move.result()
+
+    def move_together(self, positions, relative=False, timeout=None):
+        """
+        Move several motors at once and wait for all of them to arrive, such that this takes as long as the slowest
+        group does. See self.start_moves().
+        """
+        self.wait_for_moves(self.start_moves(positions, relative=relative), timeout=timeout)
+
+    @staticmethod
+    def pvt_trajectory(positions, times, velocities=None):
+        """
+        Build the content of a PVT trajectory file, for self.upload_trajectory(). Each of its elements moves the
+        positioners of a group by a displacement in a given time, ending at a given velocity, such that the group
+        passes through all points at speed rather than stopping at each.
+        :param positions: Array of shape (num_points, num_positioners) of the positions to pass through, starting with
+                          that where the trajectory starts (where the group must be when it is executed).
+        :param times: Array of the num_points - 1 durations (seconds) of the moves between consecutive positions.
+        :param velocities: Optional array of shape (num_points, num_positioners) of the velocities at each position.
+                           Defaults to finite differences, starting & ending at rest.
+        :return: The content of the trajectory file.
+        """
+        positions = np.asarray(positions, dtype=float).reshape(len(positions), -1)
+        times = np.asarray(times, dtype=float)
+        if len(times) != len(positions) - 1:
+            raise ValueError(f"Expected {len(positions) - 1} times for {len(positions)} positions but got {len(times)}")
+
+        if velocities is None:
+            segment_velocities = np.diff(positions, axis=0) / times[:, None]
+            velocities = np.zeros_like(positions)
+            velocities[1:-1] = (segment_velocities[:-1] + segment_velocities[1:]) / 2
+        velocities = np.asarray(velocities, dtype=float).reshape(positions.shape)
+
+        displacements = np.diff(positions, axis=0)
+        lines = []
+        for time, displacement, velocity in zip(times, displacements, velocities[1:]):
+            lines.append(", ".join([f"{time:.6f}"] + [f"{value:.9g}" for pair in zip(displacement, velocity)
+                                                        for value in pair]))
+        return "\n".join(lines) + "\n"
+
+    def upload_trajectory(self, filename, content):
+        """
+        Upload a trajectory file to the controller (by FTP), for self.start_trajectory(). The FTP credentials are read
+        from the "ftp_user" & "ftp_password" options of the controller's config.ini section.
+        :param filename: Name of the file on the controller.
+        :param content: Content of the file, e.g., from self.pvt_trajectory().
+        """
+        ftp = self.ftp_lib.FTP(self.host, CONFIG_INI.get(self.config_id, "ftp_user"),
+                               CONFIG_INI.get(self.config_id, "ftp_password"))
+        try:
+            ftp.cwd(self.trajectory_directory)
+            ftp.storbinary(f"STOR {filename}", io.BytesIO(content.encode()))
+        finally:
+            ftp.quit()
+
+    def start_trajectory(self, group, filename, line_arc=False, velocity=None, acceleration=None,
+                         execution_number=1):
+        """
+        Verify and start executing a trajectory uploaded by self.upload_trajectory(), without waiting for it to
+        complete. The trajectory runs from the group's own socket on a worker thread, so moves of other groups may be
+        started alongside it.
+        :param group: The group (ex: FPM_X) to run the trajectory on. PVT trajectories need a MultipleAxes group and
+                      line-arc trajectories an XY group.
+        :param filename: Name of the trajectory file on the controller.
+        :param line_arc: Whether the file is a line-arc trajectory rather than a PVT trajectory.
+        :param velocity: Trajectory velocity, required for line-arc trajectories.
+        :param acceleration: Trajectory acceleration, required for line-arc trajectories.
+        :param execution_number: Number of times to run the trajectory.
+        :return: Dict of the concurrent.futures.Future of the trajectory keyed by group, see self.wait_for_moves().
+        """
+        if line_arc and (velocity is None or acceleration is None):
+            raise ValueError("Line-arc trajectories require a velocity and acceleration.")
+        return {group: self.__submit(self.__run_trajectory, group, filename, line_arc, velocity, acceleration,
+                                     execution_number)}
+
+    def scan(self, motor_id, positions, times, filename="catkit_scan.trj"):
+        """
+        Start a scan of a single motor through several positions at speed, as a PVT trajectory, rather than a move
+        (and its round-trip) per position. Moves to the first position, then starts the trajectory without waiting
+        for it to complete, e.g., to take exposures along the way.
+        :param motor_id: String to match in the config ini (ex: motor_FPM_X). Its group must support PVT trajectories.
+        :param positions: Positions to pass through.
+        :param times: Durations (seconds) of the moves between consecutive positions.
+        :param filename: Name of the trajectory file on the controller.
+        :return: Dict of the concurrent.futures.Future of the scan keyed by group, see self.wait_for_moves().
+        """
+        self.move_together({motor_id: positions[0]})
+        self.upload_trajectory(filename, self.pvt_trajectory(positions, times))
+        return self.start_trajectory(CONFIG_INI.get(motor_id, "group_name"), filename)
+
     def get_position(self, motor_id):
         """
         Get current position
@@ -110,53 +275,130 @@ class NewportMotorController(MotorController):
         self.__raise_on_error(error_code, 'GroupPositionCurrentGet')
         return current_position
 
-    def __ensure_initialized(self, group):
-        error_code, current_status = self.instrument.GroupStatusGet(self.socket_id, group)
-        self.__raise_on_error(error_code, 'GroupStatusGet')
+    def __ensure_initialized(self, group, socket_id=None):
+        """ Drive a group to a known good state, from socket_id (which must not be used concurrently), defaulting to the
+        main socket. """
+        socket_id = self.socket_id if socket_id is None else socket_id
+        error_code, current_status = self.instrument.GroupStatusGet(socket_id, group)
+        self.__raise_on_error(error_code, 'GroupStatusGet', socket_id)
 
         # Kill motor if it is not in a known good state.
         if current_status not in self.OK_STATES:
-            error_code, return_string = self.instrument.GroupKill(self.socket_id, group)
-            self.__raise_on_error(error_code, 'GroupKill')
+            error_code, return_string = self.instrument.GroupKill(socket_id, group)
+            self.__raise_on_error(error_code, 'GroupKill', socket_id)
             self.log.warning(f"Killed group '{group}' because it was not in state '{self.OK_STATES}'")
 
             # Update the status.
-            error_code, current_status = self.instrument.GroupStatusGet(self.socket_id, group)
-            self.__raise_on_error(error_code, 'GroupStatusGet')
+            error_code, current_status = self.instrument.GroupStatusGet(socket_id, group)
+            self.__raise_on_error(error_code, 'GroupStatusGet', socket_id)
 
         # Initialize from killed state.
         if current_status == 7:
             # Initialize the group
-            error_code, return_string = self.instrument.GroupInitialize(self.socket_id, group)
-            self.__raise_on_error(error_code, 'GroupInitialize')
+            error_code, return_string = self.instrument.GroupInitialize(socket_id, group)
+            self.__raise_on_error(error_code, 'GroupInitialize', socket_id)
             self.log.info(f"Initialized group '{group}'")
 
             # Update the status
-            error_code, current_status = self.instrument.GroupStatusGet(self.socket_id, group)
-            self.__raise_on_error(error_code, 'GroupStatusGet')
+            error_code, current_status = self.instrument.GroupStatusGet(socket_id, group)
+            self.__raise_on_error(error_code, 'GroupStatusGet', socket_id)
 
         # Home search
         if current_status == 42:
-            error_code, return_string = self.instrument.GroupHomeSearch(self.socket_id, group)
-            self.__raise_on_error(error_code, 'GroupHomeSearch')
+            error_code, return_string = self.instrument.GroupHomeSearch(socket_id, group)
+            self.__raise_on_error(error_code, 'GroupHomeSearch', socket_id)
             self.log.info(f"Homed group '{group}'")
 
-    def __move_to_nominal(self, group_config_id):
-        self.__ensure_initialized(CONFIG_INI.get(group_config_id, "group_name"))
-        nominal = CONFIG_INI.getfloat(group_config_id, "nominal")
-        self.absolute_move(group_config_id, nominal)
+    def __submit(self, function, *args):
+        """ Run function on a worker thread, see self.start_moves(). """
+        if self.executor is None:
+            raise RuntimeError(f"Newport XPS Motor Controller '{self.config_id}' is not open.")
+        return self.executor.submit(function, *args)
+
+    def __open_group(self, group, moves):
+        """ Initialize a group and move it to nominal, from its own socket, timing both in self.open_profile. """
+        start = time.perf_counter()
+        with self.__group_lock(group):
+            self.__ensure_initialized(group, self.__group_socket(group))
+        initialized = time.perf_counter()
+        self.__move_group(group, moves, relative=False, initialize=False)
+        self.open_profile["groups"][group] = {"initialize": initialized - start,
+                                              "move": time.perf_counter() - initialized}
+
+    def __group_lock(self, group):
+        """ The lock serializing work on a group, see self.start_moves(). """
+        with self.__group_sockets_lock:
+            return self.__group_locks.setdefault(group, threading.Lock())
+
+    def __group_socket(self, group):
+        """ The socket of a group, see self.start_moves(), connected to on first use. Only to be used whilst holding
+        the group's lock. """
+        with self.__group_sockets_lock:
+            if group not in self.group_sockets:
+                socket_id = self.instrument.TCP_ConnectToServer(self.host, self.port, self.timeout)
+                if socket_id == -1:
+                    raise Exception(f"Connection to XPS for group '{group}' failed (invalid socket '{socket_id}')")
+                self.group_sockets[group] = socket_id
+            return self.group_sockets[group]
+
+    def __move_group(self, group, moves, relative, initialize=True):
+        """ Move positioners of a group one after another, from its own socket, after any earlier work on the group. """
+        with self.__group_lock(group):
+            self.__move_group_unlocked(group, moves, relative, initialize)
+
+    def __move_group_unlocked(self, group, moves, relative, initialize):
+        socket_id = self.__group_socket(group)
+        if initialize:
+            self.__ensure_initialized(group, socket_id)
+        for positioner, position in moves:
+            if relative:
+                self.log.info(f"Moving positioner '{positioner}' by '{position}'...")
+                error_code, return_string = self.instrument.GroupMoveRelative(socket_id, positioner, [position])
+                self.__raise_on_error(error_code, 'GroupMoveRelative', socket_id)
+            else:
+                error_code, current_position = self.instrument.GroupPositionCurrentGet(socket_id, positioner, 1)
+                self.__raise_on_error(error_code, 'GroupPositionCurrentGet', socket_id)
+                if not np.isclose(current_position, position, atol=self.atol):
+                    self.log.info(f"Moving positioner '{positioner}' to '{position}'...")
+                    error_code, return_string = self.instrument.GroupMoveAbsolute(socket_id, positioner, [position])
+                    self.__raise_on_error(error_code, 'GroupMoveAbsolute', socket_id)
+
+    def __run_trajectory(self, group, filename, line_arc, velocity, acceleration, execution_number):
+        """ Verify and execute a trajectory, from the group's own socket, after any earlier work on the group. """
+        with self.__group_lock(group):
+            self.__run_trajectory_unlocked(group, filename, line_arc, velocity, acceleration, execution_number)
+
+    def __run_trajectory_unlocked(self, group, filename, line_arc, velocity, acceleration, execution_number):
+        socket_id = self.__group_socket(group)
+        self.__ensure_initialized(group, socket_id)
+        if line_arc:
+            error_code, return_string = self.instrument.XYLineArcVerification(socket_id, group, filename)
+            self.__raise_on_error(error_code, 'XYLineArcVerification', socket_id)
+            self.log.info(f"Executing line-arc trajectory '{filename}' on group '{group}'...")
+            error_code, return_string = self.instrument.XYLineArcExecution(socket_id, group, filename, velocity,
+                                                                           acceleration, execution_number)
+            self.__raise_on_error(error_code, 'XYLineArcExecution', socket_id)
+        else:
+            error_code, return_string = self.instrument.MultipleAxesPVTVerification(socket_id, group, filename)
+            self.__raise_on_error(error_code, 'MultipleAxesPVTVerification', socket_id)
+            self.log.info(f"Executing PVT trajectory '{filename}' on group '{group}'...")
+            error_code, return_string = self.instrument.MultipleAxesPVTExecution(socket_id, group, filename,
+                                                                                 execution_number)
+            self.__raise_on_error(error_code, 'MultipleAxesPVTExecution', socket_id)
 
     # Migrated from Newport demo code, now raises exceptions and does logging elsewhere.
-    def __raise_on_error(self, error_code, api_name):
+    def __raise_on_error(self, error_code, api_name, socket_id=None):
         if error_code == 0:
             return
 
+        socket_id = self.socket_id if socket_id is None else socket_id
+
         if error_code == -2:
             raise Exception(f"{api_name}: TCP timeout")
         elif error_code == -108:
             raise Exception(f"{api_name}: The TCP/IP connection was closed by an administrator")
         else:
-            error_code2, error_string = self.instrument.ErrorStringGet(self.socket_id, error_code)
+            error_code2, error_string = self.instrument.ErrorStringGet(socket_id, error_code)
             if error_code2 != 0:
                 raise Exception(f"{api_name}: ERROR '{error_code}'")
             else:
@@ -14,12 +14,13 @@ According to the manual, this should hold for models:
 import functools
 
 from http.client import IncompleteRead
+import time
+
 import numpy as np
-from photutils import centroid_1dg, centroid_2dg
+import requests
 from requests.exceptions import HTTPError
-import urllib
-from urllib.parse import urlencode
 
+from catkit import centroiding
 from catkit.interfaces.MotorController2 import MotorController2
 import catkit.util
 
@@ -40,10 +41,16 @@ def http_except(function):
 class NewportPicomotorController(MotorController2):
     """ This class handles all the picomotor stufff. """
     
-    instrument_lib = urllib.request
+    instrument_lib = requests
+
+    # How often (seconds) to poll whether motors are done moving, see self._wait_for_motion().
+    motion_poll_interval = 0.005
+    # How long (seconds) beyond the time a move is expected to take to wait for the motors to be done moving, see
+    # self._wait_for_motion().
+    motion_timeout = 10
 
     def initialize(self, ip, max_step, timeout, daisy, sleep_per_step=0.0005, 
-            calibration=None, home_reset=True, centroid_method=None):
+            calibration=None, home_reset=True, centroid_method=None, centroid_roi_size=None):
         """ Initial function set the IP address for the controller. Anything set to None will attempt to
         pull from the config file.
         
@@ -64,8 +71,13 @@ class NewportPicomotorController(MotorController2):
         home_reset : bool, optional
             Whether or not to reset to the home position on controller close.
             Defaults to True.
-        centroid_method : str, optional
-            '1d' or '2d' for centroid method. Defaults to 1d.
+        centroid_method : str or callable, optional
+            '1d' or '2d' for photutils' Gaussian fits, 'com', 'thresholded_com', 'windowed_com' or 'quadratic' for
+            the much faster methods of catkit.centroiding, or a callable taking an image and returning (x, y).
+            Defaults to 1d.
+        centroid_roi_size : int, optional
+            If given, only centroid within a region of interest of this size (pixels) around the previous centroid,
+            which must then be large enough to contain the spot after a move. Defaults to the full images.
         """
 
         # Set vital connection parameters
@@ -84,38 +96,34 @@ class NewportPicomotorController(MotorController2):
         self.cmd_dict = {'home_position': 'DH', 'exact_move': 'PA', 
                          'relative_move': 'PR', 'reset': 'RS',
                          'relative_move': 'PR', 'reset': 'RS',
-                         'error_message': 'TB'}
+                         'error_message': 'TB', 'motion_done': 'MD'}
         
         self.calibration = {} if calibration is None else calibration
         
-        if centroid_method is None:
-            self.centroid_method = centroid_1dg
-        elif centroid_method == '1d':
-            self.centroid_method = centroid_1dg
-        elif centroid_method == '2d':
-            self.centroid_method = centroid_2dg
-        else:
-            raise NotImplementedError('Only 1D an 2D centroiding is available.')
+        self.centroid_method = centroiding.get_method('1d' if centroid_method is None else centroid_method)
+        self.centroid_roi_size = centroid_roi_size
+        # (x, y) of the last centroid, see self.find_centroid().
+        self.last_centroid = None
 
 
     def _open(self):
         """ Function to test a connection (ping the address and see if it
-        sticks). """
+        sticks). All requests then go through this session, which keeps the
+        connection alive rather than opening one per request. """
+        session = self.instrument_lib.Session()
         try:
-            self.instrument_lib.urlopen(f'http://{self.ip}', timeout=self.timeout)
-        except  Exception as e:
-            raise OSError(f"The controller IP address : {self.ip} is not responding.") from e
+            session.get(f'http://{self.ip}', timeout=self.timeout).raise_for_status()
+        except Exception as e:
+            session.close()
             self.log.critical(f"The controller IP address : {self.ip} is not responding.")
-            
-        # Since there's no useful "object" to connect to here, instrument is
-        # set to True to allow for open/close behavior 
-        self.instrument = True
+            raise OSError(f"The controller IP address : {self.ip} is not responding.") from e
+
+        self.instrument = session
         self.log.info(f'IP address : {self.ip}, is online, and logging instantiated.')
         
         # Save current position as home.
-        for axis in '1234':
-            self.command('home_position', int(axis), 0)
-            self.log.info('Current position saved as home.')
+        self.set_home()
+        self.log.info('Current position saved as home.')
         
         return self.instrument
 
@@ -123,16 +131,25 @@ class NewportPicomotorController(MotorController2):
         """ Function for the close behavior. Return every parameter to zero
         and shut down the logging."""
         
-        if self.home_reset:
-            self.reset_controller()
+        try:
+            if self.home_reset:
+                self.reset_controller()
+        finally:
+            self.instrument.close()
 
     def reset_controller(self):
         """Function to reset the motors to where they started (or were last reset.)"""
         
-        for axis in '1234':
-            self.command('exact_move', int(axis), 0)
-            self.command('home_position', int(axis), 0)
-            self.log.info('Controller reset.')
+        self.move({axis: 0 for axis in range(1, 5)}, relative=False)
+        self.set_home()
+        self.log.info('Controller reset.')
+
+    @http_except
+    def set_home(self):
+        """ Save the current position of all axes as their home, in a single request. """
+
+        self._send_message(';'.join(self._build_message('home_position', 'set', axis, 0) for axis in range(1, 5)),
+                           'set')
         
     def absolute_move(self, axis, value):
         """ Function to make an absolute move.
@@ -164,6 +181,41 @@ class NewportPicomotorController(MotorController2):
         
         self.command('relative_move', axis, value)
 
+    @http_except
+    def move(self, moves, relative=True):
+        """ Move several axes at once. The moves are chained into a single
+        request, such that the motors move simultaneously, and the moves
+        complete in the time of the longest one.
+
+        Parameters
+        ----------
+        moves : dict
+            Number of steps (int) to move by, or to, keyed by axis (int).
+        relative : bool, optional
+            Whether to make relative (default) or absolute moves.
+        """
+
+        cmd_key = 'relative_move' if relative else 'exact_move'
+        set_message = ';'.join(self._build_message(cmd_key, 'set', axis, value) for axis, value in moves.items())
+
+        initial_values = {axis: float(self._send_message(self._build_message(cmd_key, 'get', axis), 'get'))
+                          for axis in moves}
+
+        self._send_message(set_message, 'set')
+        # Absolute moves take as long as the distance from where the motors are.
+        self._wait_for_motion(moves, max(np.abs(value if relative else value - initial_values[axis])
+                                         for axis, value in moves.items()))
+
+        for axis, value in moves.items():
+            set_value = float(self._send_message(self._build_message(cmd_key, 'get', axis), 'get')) - \
+                (initial_values[axis] if relative else 0)
+            if set_value != value:
+                error_msg = f"Newport Pico Motor axis {axis} failed to move as {set_value} != {value}."
+                self.log.error(error_msg)
+                raise RuntimeError(error_msg)
+
+        self.log.info(f'Command sent. Action : {cmd_key}. Moves : {moves}')
+
     @http_except
     def command(self, cmd_key, axis, value):
         """ Function to send a command to the controller.
@@ -182,20 +234,20 @@ class NewportPicomotorController(MotorController2):
         set_message = self._build_message(cmd_key, 'set', axis, value)
         get_message = self._build_message(cmd_key, 'get', axis)
         
-        initial_value = self._send_message(get_message, 'get') if cmd_key == 'relative_move' else 0
+        is_move = cmd_key in ('exact_move', 'relative_move')
+        initial_value = float(self._send_message(get_message, 'get')) if is_move else 0
         
         self._send_message(set_message, 'set')
         
-        # Calculate time move will take so we don't overlap messages
-        # Keep in mind sometimes steps are negative
-        # Default velocity is 2000 steps/second
-        move_time = np.abs(value*self.sleep_per_step)
-        catkit.util.sleep(move_time)
+        if is_move:
+            # Absolute moves take as long as the distance from where the motor is.
+            self._wait_for_motion([axis], np.abs(value if cmd_key == 'relative_move' else value - initial_value))
         
-        set_value = float(self._send_message(get_message, 'get')) - float(initial_value)
+        set_value = float(self._send_message(get_message, 'get')) - \
+            (initial_value if cmd_key == 'relative_move' else 0)
         
         if float(set_value) != value:
-            error_msg = f"Newport Pico Motor failed to move as {set_value} != {value}. Try increasing sleep duration."
+            error_msg = f"Newport Pico Motor failed to move as {set_value} != {value}."
             self.log.error(error_msg)
             raise RuntimeError(error_msg)
          
@@ -228,8 +280,8 @@ class NewportPicomotorController(MotorController2):
             The difference between the angle from x and the picomotor axis.
         """
 
-        x1, y1 = self.centroid_method(img_before)
-        x2, y2 = self.centroid_method(img_after)
+        x1, y1 = self.find_centroid(img_before)
+        x2, y2 = self.find_centroid(img_after)
 
         x_move = x1 - x2
         y_move = y1 - y2
@@ -253,6 +305,25 @@ class NewportPicomotorController(MotorController2):
         
         return r, theta, r_ratio, delta_theta
     
+    def find_centroid(self, image):
+        """ Centroid the spot in an image with self.centroid_method, within a region of interest around the previous
+        centroid if self.centroid_roi_size is set.
+
+        Parameters
+        ----------
+        image : np.array
+            Image of the spot.
+
+        Returns
+        -------
+        x, y : float
+            The position of the spot in pixels.
+        """
+        center = self.last_centroid if self.centroid_roi_size else None
+        self.last_centroid = centroiding.centroid(image, self.centroid_method, center=center,
+                                                  size=self.centroid_roi_size)
+        return self.last_centroid
+
     @http_except
     def get_status(self, axis):
         """Checks the status of the relative/absolute positions and home 
@@ -287,6 +358,33 @@ class NewportPicomotorController(MotorController2):
         self._send_message(message, 'set')
         self.log.info('Controller reset.')
 
+    def _wait_for_motion(self, axes, steps):
+        """ Wait until the given axes are done moving. Rather than polling
+        throughout, sleep for most of the time the move is expected to take,
+        then poll the motion done status (MD?) of each axis in turn, for up to
+        self.motion_timeout longer.
+
+        Parameters
+        ----------
+        axes : iterable of int
+            The axes that are moving.
+        steps : int
+            The largest number of steps moved, to estimate the time the move
+            takes from sleep_per_step (the default velocity is 2000 steps per
+            second).
+        """
+
+        move_time = steps * self.sleep_per_step
+        deadline = time.monotonic() + move_time + self.motion_timeout
+        catkit.util.sleep(0.9 * move_time)
+
+        for axis in axes:
+            while not int(self._send_message(self._build_message('motion_done', 'get', axis), 'get')):
+                if time.monotonic() > deadline:
+                    raise RuntimeError(f"Newport Pico Motor axis {axis} is still moving after "
+                                       f"{move_time + self.motion_timeout} s.")
+                catkit.util.sleep(self.motion_poll_interval)
+
     def _build_message(self, cmd_key, cmd_type, axis=None, value=None):
         """Build a message for the newport picomotor controller.
 
@@ -344,7 +442,8 @@ class NewportPicomotorController(MotorController2):
         Parameters
         ----------
         message : str
-            The message to send to the controller.
+            The message to send to the controller. Several commands can be
+            chained, separated by semicolons.
         cmd_type : str
             Get or set -- for whether to get the value or set the controller.
 
@@ -355,13 +454,14 @@ class NewportPicomotorController(MotorController2):
             controller), it will return the value.
         """
         
-        form_data = urlencode({'cmd': message, 'submit': 'Send'})
-        with self.instrument_lib.urlopen(f'http://{self.ip}/cmd_send.cgi?{form_data}', timeout=self.timeout) as html:
-            resp = str(html.read())
+        r = self.instrument.get(f'http://{self.ip}/cmd_send.cgi', params={'cmd': message, 'submit': 'Send'},
+                                timeout=self.timeout)
+        r.raise_for_status()
+        resp = r.text
         
         if cmd_type == 'get':
             # Pull out the response from the html on the page 
-            # The output will be nestled between --> and \\r
-            response = resp.split('response')[1].split('-->')[1].split('\\r')[0]
+            # The output will be nestled between --> and \r
+            response = resp.split('response')[1].split('-->')[1].split('\r')[0]
 
             return response
@@ -4,6 +4,7 @@ Connects to the controller via usb using pvisa and FTDI drivers.
 """
 
 
+from collections import namedtuple
 import enum
 import functools
 import math
@@ -11,9 +12,11 @@ import os
 import struct
 import time
 
+import numpy as np
 import pyvisa
 
 from catkit.interfaces.ClosedLoopController import ClosedLoopController
+import catkit.util
 
 
 class Parameters(enum.Enum):
@@ -23,6 +26,8 @@ class Parameters(enum.Enum):
     P_GAIN = (0x720, 2, 'd')
     I_GAIN = (0x728, 2, 'd')
     D_GAIN = (0x730, 2, 'd')
+    # Digital position command, in signed counts of the channel's range.
+    SETPOINT = (0x218, 1, 'i')
 
     def __init__(self, hex_code, data_length, data_type_fmt):
         self.hex_code = hex_code
@@ -43,10 +48,21 @@ class Commands(enum.Enum):
     GET_ARRAY = b'\xa4'
 
 
+# The outcome of NPointLC400.stream_waveform().
+# samples is the number of samples streamed, duration the seconds from starting until the last chunk was written, rate
+# the achieved samples per second, as measured by when the last chunk was written (NaN for a single chunk), underruns the
+# number of chunks written more than a sample period late and max_lateness the latest (seconds) of them.
+StreamReport = namedtuple("StreamReport", ["samples", "duration", "rate", "underruns", "max_lateness"])
+
+
 class NPointLC400(ClosedLoopController):
     
     instrument_lib = pyvisa
 
+    # The settings of each channel's control loop, as reported by get_status() and reset on close. The setpoint isn't
+    # one of them, such that the mirror isn't commanded to move upon close.
+    loop_parameters = (Parameters.LOOP, Parameters.P_GAIN, Parameters.I_GAIN, Parameters.D_GAIN)
+
     endpoint = b'\x55'
     # The channels get summed with the parameters to yield an address so for convenience leave these as ints.
     base_channel_address = 0x11830000
@@ -76,6 +92,11 @@ class NPointLC400(ClosedLoopController):
         0x11831000 := Ch1 base address
         0x11832000 := Ch2 base address
         """
+        return struct.pack(cls.endian + 'I', cls.int_address(parameter, channel))  # 'I' := unsigned int.
+
+    @classmethod
+    def int_address(cls, parameter, channel):
+        """ The address of a parameter of a channel, as an int. See build_address(). """
 
         if parameter not in Parameters:
             raise ValueError(f"Parameter must be one of {[param for param in Parameters]}.")
@@ -84,14 +105,12 @@ class NPointLC400(ClosedLoopController):
             raise ValueError(f"Channel must be one of {cls.channels}")
 
         # + := int addition.
-        address = cls.base_channel_address + channel*cls.channel_address_offset + parameter.hex_code
-
-        return struct.pack(cls.endian + 'I', address)  # 'I' := unsigned int.
+        return cls.base_channel_address + channel*cls.channel_address_offset + parameter.hex_code
 
     def _close(self):
-        # Reset everything to 0.
+        # Reset the control loops to 0.
         for channel in self.channels:
-            for parameter in Parameters:
+            for parameter in self.loop_parameters:
                 self.set(parameter, channel, 0)
         self.instrument.close()
 
@@ -131,6 +150,22 @@ class NPointLC400(ClosedLoopController):
             Return Value: 0xA4 [addr] [data 1].....[data N] 0x55
         """
         # Construct message.
+        message, bytes_to_read = self._get_message(parameter, channel)
+
+        # Send GET.
+        self._send(message)
+
+        # Read response.
+        resp = self._read(bytes_to_read)
+
+        # Parse response.
+        resp_command, resp_parameter, resp_address, resp_channel, value = self.parse_message(resp)
+        self._check_sync(parameter, channel, resp_command, resp_parameter, resp_address, resp_channel)
+
+        return value
+
+    def _get_message(self, parameter, channel):
+        """ The GET message for a parameter of a channel, and the length of its response. """
         address = self.build_address(parameter, channel)
         n_reads = parameter.data_length
         if n_reads == 1:
@@ -138,18 +173,58 @@ class NPointLC400(ClosedLoopController):
         else:
             n_reads_message = struct.pack(self.endian + 'I', n_reads)
             message = b''.join([Commands.GET_ARRAY.value, address, n_reads_message, self.endpoint])
+        bytes_to_read = 1 + 4 + n_reads*4 + 1  # command + address + n_reads*data + endpoint.
+        return message, bytes_to_read
 
-        # Send GET.
-        self._send(message)
+    def get_many(self, parameters):
+        """ Get several parameters, of one or more channels, in a single round-trip.
 
-        # Read response.
+        Reads the whole block of consecutive addresses spanning all of them with a single GET_ARRAY, and decodes it at
+        once. Parameters that are far apart, e.g., of different channels, make for a large block (up to ~6kB for all
+        parameters of both channels), which still costs less than a round-trip per parameter.
+
+        Parameters
+        ----------
+        parameters : iterable of (Parameters, int)
+            (parameter, channel) pairs to get.
+
+        Returns
+        -------
+        dict
+            Values keyed by (parameter, channel).
+        """
+        parameters = list(dict.fromkeys(parameters))  # Unique, in order.
+        addresses = [self.int_address(parameter, channel) for parameter, channel in parameters]
+        start = min(addresses)
+        n_reads = (max(address + parameter.data_length * 4 for address, (parameter, _) in zip(addresses, parameters))
+                   - start) // 4
+
+        # Send GET_ARRAY of the whole block.
+        address = struct.pack(self.endian + 'I', start)
+        self._send(b''.join([Commands.GET_ARRAY.value, address, struct.pack(self.endian + 'I', n_reads), self.endpoint]))
+
+        # Read & check response: 0xA4 [addr] [data 1].....[data N] 0x55
         bytes_to_read = 1 + 4 + n_reads*4 + 1  # command + address + n_reads*data + endpoint.
         resp = self._read(bytes_to_read)
+        if len(resp) != bytes_to_read or resp[:1] != Commands.GET_ARRAY.value or resp[-1:] != self.endpoint:
+            raise RuntimeError(f"Reads and writes out of sync. Expected {bytes_to_read}B GET_ARRAY response but got "
+                               f"{len(resp)}B starting with '{resp[:1]}'")
+        if resp[1:5] != address:
+            raise RuntimeError(f"Reads and writes out of sync. Expected address '{address}' but got '{resp[1:5]}")
+
+        # Decode all values at once, as fields of a single record spanning the block.
+        dtype = np.dtype({"names": [f"{parameter.name}_{channel}" for parameter, channel in parameters],
+                          "formats": [self.endian + parameter.data_type_fmt.replace('I', 'u4').replace('d', 'f8')
+                                      for parameter, _ in parameters],
+                          "offsets": [address - start for address in addresses],
+                          "itemsize": n_reads * 4})
+        record = np.frombuffer(resp, dtype=dtype, count=1, offset=5)[0]
+        return {pair: record[i].item() for i, pair in enumerate(parameters)}
 
-        # Parse response.
-        resp_command, resp_parameter, resp_address, resp_channel, value = self.parse_message(resp)
-
-        # Check to ensure that reads are in sync.
+    @classmethod
+    def _check_sync(cls, parameter, channel, resp_command, resp_parameter, resp_address, resp_channel):
+        """ Check to ensure that reads are in sync, i.e., that a parsed GET response is that of parameter & channel. """
+        address = cls.build_address(parameter, channel)
         if resp_command not in (Commands.GET_SINGLE, Commands.GET_ARRAY):
             raise RuntimeError(f"Reads and writes out of sync. Expected GET Command but got '{resp_command}")
         if resp_parameter is not parameter:
@@ -159,8 +234,6 @@ class NPointLC400(ClosedLoopController):
         if resp_channel != channel:
             raise RuntimeError(f"Reads and writes out of sync. Expected channel '{channel}' but got '{resp_channel}")
 
-        return value
-
     def set(self, parameter, channel, value):
         """
         (addr and data are 32b (4B) each).
@@ -173,6 +246,10 @@ class NPointLC400(ClosedLoopController):
             Format: 0xA3 [data] 0x55
             Return Value: none
         """
+        self._send(self._set_messages(parameter, channel, value))
+
+    def _set_messages(self, parameter, channel, value):
+        """ The SET (and SECOND_MSG) message(s) setting a parameter of a channel to value. """
         if not isinstance(value, (int, float)):
             raise TypeError(f"Parameter values must be int or float not {type(value)}")
 
@@ -181,34 +258,204 @@ class NPointLC400(ClosedLoopController):
         data_type_fmt = parameter.data_type_fmt
         if data_type_fmt == 'I':
             value = struct.pack(self.endian + data_type_fmt, 1 if value else 0)
-            self._send(b''.join([Commands.SET.value, address, value, self.endpoint]))
+            return [b''.join([Commands.SET.value, address, value, self.endpoint])]
+        elif data_type_fmt == 'i':
+            value = struct.pack(self.endian + data_type_fmt, int(value))
+            return [b''.join([Commands.SET.value, address, value, self.endpoint])]
         elif data_type_fmt == 'd':
             value = struct.pack(self.endian + data_type_fmt, float(value))
             # Send value in two halves.
-            self._send([b''.join([Commands.SET.value, address, value[:4], self.endpoint]),
-                        b''.join([Commands.SECOND_MSG.value, value[4:], self.endpoint])])
+            return [b''.join([Commands.SET.value, address, value[:4], self.endpoint]),
+                    b''.join([Commands.SECOND_MSG.value, value[4:], self.endpoint])]
         else:
             raise NotImplementedError("Supports only 32b ints and 64b floats.")
 
+    def set_many(self, values, verify=True):
+        """ Set several parameters, of one or more channels, e.g., P/I/D gains of both channels, at once.
+
+        All writes are sent back-to-back in a single write. If verifying, all GETs are then sent back-to-back in a single
+        write and their responses read at once, each being parsed & checked to be in sync (as by get()), such that this
+        costs a single round-trip however many parameters are set.
+
+        Parameters
+        ----------
+        values : dict
+            Values keyed by (parameter, channel).
+        verify : bool
+            Whether to read all values back and check that they were set.
+
+        Returns
+        -------
+        dict
+            The values read back keyed by (parameter, channel), if verifying.
+
+        Raises
+        ------
+        ValueError
+            If any value read back differs from that set, listing all that do.
+        """
+        self._send(b''.join(message for (parameter, channel), value in values.items()
+                            for message in self._set_messages(parameter, channel, value)))
+        if not verify:
+            return None
+
+        get_messages = [self._get_message(parameter, channel) for parameter, channel in values]
+        self._send(b''.join(message for message, _ in get_messages))
+        resp = self._read(sum(bytes_to_read for _, bytes_to_read in get_messages))
+
+        set_values = {}
+        start = 0
+        for (parameter, channel), (_, bytes_to_read) in zip(values, get_messages):
+            resp_command, resp_parameter, resp_address, resp_channel, value = \
+                self.parse_message(resp[start:start + bytes_to_read])
+            self._check_sync(parameter, channel, resp_command, resp_parameter, resp_address, resp_channel)
+            set_values[(parameter, channel)] = value
+            start += bytes_to_read
+
+        failures = {key: (value, set_values[key]) for key, value in values.items() if value != set_values[key]}
+        if failures:
+            raise ValueError(f'Command was NOT successful for {len(failures)} parameters (set != read): {failures}.')
+        self.log.debug(f'Command successful: {set_values}.')
+        return set_values
+
+    @classmethod
+    def encode_waveform(cls, values, parameter=Parameters.SETPOINT, channels=None):
+        """ Pre-encode a waveform into the bytes of all the SET (and SECOND_MSG, for 64b parameters) messages setting it,
+        one sample after another, see stream_waveform().
+
+        Parameters
+        ----------
+        values : numpy.ndarray
+            Values of shape (n_samples, len(channels)), or (n_samples,) for a single channel.
+        parameter : Parameters
+            Parameter to set.
+        channels : tuple of int, optional
+            Channels to set, defaults to all.
+
+        Returns
+        -------
+        bytes
+            The messages, len(channels) per sample, all of equal length.
+        """
+        channels = cls.channels if channels is None else tuple(channels)
+        values = np.asarray(values).reshape(len(values), -1)
+        if values.shape[1] != len(channels):
+            raise ValueError(f"Expected values for {len(channels)} channels but got {values.shape[1]}.")
+
+        # A record per sample, of a message (or two) per channel.
+        # Format: 0xA2 [addr] [data] 0x55 (& 0xA3 [data] 0x55).
+        data_type_fmt = parameter.data_type_fmt
+        fields = []
+        for channel in channels:
+            fields += [(f"set_{channel}", 'u1'), (f"address_{channel}", cls.endian + 'u4'),
+                       (f"data_{channel}", cls.endian + 'u4'), (f"endpoint_{channel}", 'u1')]
+            if data_type_fmt == 'd':
+                fields += [(f"second_msg_{channel}", 'u1'), (f"second_data_{channel}", cls.endian + 'u4'),
+                           (f"second_endpoint_{channel}", 'u1')]
+        frames = np.empty(len(values), dtype=np.dtype(fields))
+
+        for i, channel in enumerate(channels):
+            frames[f"set_{channel}"] = Commands.SET.value[0]
+            frames[f"address_{channel}"] = cls.int_address(parameter, channel)
+            frames[f"endpoint_{channel}"] = cls.endpoint[0]
+            if data_type_fmt == 'I':
+                frames[f"data_{channel}"] = values[:, i] != 0
+            elif data_type_fmt == 'i':
+                frames[f"data_{channel}"] = np.round(values[:, i]).astype(cls.endian + 'i4').view(cls.endian + 'u4')
+            elif data_type_fmt == 'd':
+                halves = values[:, i].astype(cls.endian + 'f8').view(cls.endian + 'u4').reshape(-1, 2)
+                frames[f"data_{channel}"] = halves[:, 0]
+                frames[f"second_msg_{channel}"] = Commands.SECOND_MSG.value[0]
+                frames[f"second_data_{channel}"] = halves[:, 1]
+                frames[f"second_endpoint_{channel}"] = cls.endpoint[0]
+            else:
+                raise NotImplementedError("Supports only 32b ints and 64b floats.")
+        return frames.tobytes()
+
+    def stream_waveform(self, values, rate, parameter=Parameters.SETPOINT, channels=None, chunk_size=None,
+                        spin_time=0.002):
+        """ Stream a waveform, e.g., of tip/tilt setpoints, at a fixed rate.
+
+        The waveform is encoded up front (see encode_waveform()) and written in chunks of chunk_size samples, each
+        written when its first sample is due. Within a chunk, samples are applied as fast as the controller receives
+        them, so use smaller chunks for more precise pacing and larger ones for higher rates. Waits are slept, bar the
+        last spin_time seconds which are spun for precision.
+
+        Parameters
+        ----------
+        values : numpy.ndarray
+            Values of shape (n_samples, len(channels)), or (n_samples,) for a single channel.
+        rate : float
+            Samples per second.
+        parameter : Parameters
+            Parameter to set.
+        channels : tuple of int, optional
+            Channels to set, defaults to all.
+        chunk_size : int, optional
+            Samples per write, defaults to ~10ms of samples.
+        spin_time : float
+            Seconds before each write to spin rather than sleep for.
+
+        Returns
+        -------
+        StreamReport
+        """
+        if len(values) == 0:
+            raise ValueError("Expected a waveform of at least one sample.")
+        channels = self.channels if channels is None else tuple(channels)
+        encoded = memoryview(self.encode_waveform(values, parameter=parameter, channels=channels))
+        n_samples = len(values)
+        sample_size = len(encoded) // n_samples
+        chunk_size = max(1, int(rate / 100)) if chunk_size is None else chunk_size
+        period = 1 / rate
+
+        underruns = 0
+        max_lateness = 0.
+        start = time.perf_counter()
+        for first in range(0, n_samples, chunk_size):
+            due = start + first * period
+            remaining = due - time.perf_counter()
+            if remaining > spin_time:
+                catkit.util.sleep(remaining - spin_time)
+            while time.perf_counter() < due:
+                pass
+
+            last_write = time.perf_counter()
+            lateness = last_write - due
+            if lateness > period:
+                underruns += 1
+                max_lateness = max(max_lateness, lateness)
+            self._send(encoded[first * sample_size:(first + chunk_size) * sample_size].tobytes())
+        duration = time.perf_counter() - start
+        # The samples before the last chunk took until it was written.
+        achieved_rate = first / (last_write - start) if first else math.nan
+
+        report = StreamReport(n_samples, duration, achieved_rate, underruns, max_lateness)
+        log = self.log.warning if underruns else self.log.info
+        log(f"Streamed {n_samples} samples of {parameter} to channels {channels} at {report.rate:.1f}Hz (asked for "
+            f"{rate}Hz) with {underruns} underruns.")
+        return report
+
     def set_and_check(self, parameter, channel, value):
-        self.set(parameter, channel, value)
-        set_value = self.get(parameter, channel)
-        if value != set_value:
-            raise ValueError(f'Command was NOT successful : {value} != {set_value}.')  # RT error?
-        self.log.debug(f'Command successful: {value} == {set_value}.')
+        self.set_many({(parameter, channel): value}, verify=True)
         
     def get_status(self, channel):
-        """ Get the value of all parameter: loop, and p/i/d_gain for the specified channel. Returns a dict. """
-        value_dict = {}
-        for parameter in Parameters:
-            value_dict[parameter] = self.get(parameter, channel)
+        """ Get the value of all parameter: loop, and p/i/d_gain for the specified channel, in a single round-trip (see
+        get_many()). Returns a dict. """
+        values = self.get_many((parameter, channel) for parameter in self.loop_parameters)
+        value_dict = {parameter: values[(parameter, channel)] for parameter in self.loop_parameters}
         self.log.info(f"Status: {value_dict}")
-        return value_dict 
+        return value_dict
 
     def set_closed_loop(self, active=True):
-        """ Activate closed-loop control on all channels. """
+        """ Activate closed-loop control on all channels, then check all of them at once. """
         for channel in self.channels:
-            self.set_and_check(Parameters.LOOP, channel, active)
+            self.set(Parameters.LOOP, channel, active)
+        values = self.get_many((Parameters.LOOP, channel) for channel in self.channels)
+        for (_, channel), set_value in values.items():
+            if active != set_value:
+                raise ValueError(f'Command was NOT successful on channel {channel}: {active} != {set_value}.')
+        self.log.debug(f'Command successful: {active} == {list(values.values())}.')
 
     @classmethod
     def parse_message(cls, message):
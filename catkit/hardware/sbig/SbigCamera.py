@@ -1,14 +1,18 @@
 from catkit.catkit_types import MetaDataEntry
+from catkit.fits_writer import FitsWriterPool
 from catkit.interfaces.Camera import Camera
 from catkit.config import CONFIG_INI
 from catkit.catkit_types import units, quantity
 import catkit.util
 from astropy.io import fits
 import numpy as np
+import concurrent.futures
+import contextlib
 import logging
 import os
 import requests
 import sys
+import time
 
 import catkit.util
 
@@ -29,18 +33,59 @@ class SbigCamera(Camera):
     NO_IMAGE_AVAILABLE = 0
     IMAGE_AVAILABLE = 1
 
+    # Chunk size (bytes) in which images are downloaded into the preallocated image buffer.
+    download_chunk_size = 1024 ** 2
+
+    # Factor by which to shorten the readout time estimate when the imager is already idle at the first poll, see
+    # self.__wait_for_exposure(). The time taken then only bounds the readout from above, so the estimate is shortened
+    # until a poll catches the readout again, and only then measured. Close to 1 such that the estimate stays close to
+    # the actual readout (oversleeping by less than 10%), whilst still recovering from an overestimate, e.g., after a
+    # slow exposure, within a few exposures (7 to halve it).
+    readout_time_decay = 0.9
+
+    instrument_lib = requests
     log = logging.getLogger(__name__)
 
     def initialize(self, *args, **kwargs):
-        """Loads the SBIG config information and verifies that the camera is idle.
-           Uses the config_id to look up parameters in the config.ini"""
+        """Loads the SBIG config information. Uses the config_id to look up parameters in the config.ini"""
 
         # find the SBIG config information
-        camera_name = CONFIG_INI.get(self.config_id, "camera_name")
+        self.camera_name = CONFIG_INI.get(self.config_id, "camera_name")
         self.base_url = CONFIG_INI.get(self.config_id, "base_url")
         self.timeout = CONFIG_INI.getint(self.config_id, "timeout")
         self.min_delay = CONFIG_INI.getfloat(self.config_id, 'min_delay')
 
+        # These don't change per exposure, so only read them once.
+        self.cooler_state = CONFIG_INI.getint(self.config_id, 'cooler_state')
+        self.detector_width = CONFIG_INI.getint(self.config_id, 'detector_width')
+        self.detector_length = CONFIG_INI.getint(self.config_id, 'detector_length')
+        self.theta = CONFIG_INI.getint(self.config_id, 'image_rotation')
+        self.fliplr = CONFIG_INI.getboolean(self.config_id, 'image_fliplr')
+        # Whether the camera keeps serving the last image whilst the next is exposed, see self.__capture_pipelined().
+        self.pipelined = CONFIG_INI.getboolean(self.config_id, 'pipelined', fallback=False)
+        self.config_defaults = dict(subarray_x=CONFIG_INI.getint(self.config_id, 'subarray_x'),
+                                    subarray_y=CONFIG_INI.getint(self.config_id, 'subarray_y'),
+                                    width=CONFIG_INI.getint(self.config_id, 'width'),
+                                    height=CONFIG_INI.getint(self.config_id, 'height'),
+                                    full_image=CONFIG_INI.getboolean(self.config_id, 'full_image'),
+                                    bins=CONFIG_INI.getint(self.config_id, 'bins'))
+
+        # Images are downloaded into this buffer, (re)allocated when the image size changes.
+        self.image_buffer = None
+        self.image_shape = None
+        self.software_bins = 1
+
+        # How long (seconds) the last exposure took from its end until the imager was idle again (i.e., readout), used
+        # to schedule polling of the next, see self.__wait_for_exposure().
+        self.readout_time = 0
+
+        self.imager_status = None
+
+    def _open(self):
+        """ Open a persistent HTTP session, such that all requests reuse the same (keep-alive) connection, and verify
+        that the camera is idle. """
+        self.instrument = self.instrument_lib.Session()
+
         # check the status, which should be idle
         imager_status = self.__check_imager_state()
         if imager_status > self.IMAGER_STATE_IDLE:
@@ -48,16 +93,17 @@ class SbigCamera(Camera):
             raise Exception("Camera reported incorrect state (" + str(imager_status) + ") during initialization.")
 
         self.imager_status = imager_status
-
-    def close(self):
-        # check status and abort any imaging in progress
-        imager_status = self.__check_imager_state()
-        if imager_status > self.IMAGER_STATE_IDLE:
-            # work in progress, abort the exposure
-            catkit.util.sleep(self.min_delay)  # limit the rate at which requests go to the camera
-            r = requests.get(self.base_url + "ImagerAbortExposure.cgi")
-            # no data is returned, but an http error indicates if the abort failed
-            r.raise_for_status()
+        return self.instrument
+
+    def _close(self):
+        try:
+            # check status and abort any imaging in progress
+            imager_status = self.__check_imager_state()
+            if imager_status > self.IMAGER_STATE_IDLE:
+                # work in progress, abort the exposure
+                self.__abort_exposure()
+        finally:
+            self.instrument.close()
 
     def take_exposures(self, exposure_time, num_exposures,
                        file_mode=False, raw_skip=0, path=None, filename=None,
@@ -65,7 +111,7 @@ class SbigCamera(Camera):
                        resume=False,
                        return_metadata=False,
                        subarray_x=None, subarray_y=None, width=None, height=None, gain=None, full_image=None,
-                       bins=None):
+                       bins=None, pipelined=None):
         """
         Low level method to take exposures using an SBIG camera. By default keeps image data in memory
         :param exposure_time: Pint quantity for exposure time, otherwise in microseconds.
@@ -84,33 +130,21 @@ class SbigCamera(Camera):
         :param gain: Gain is ignored for the SBIG camera; the API doesn't have a way to set gain.
         :param full_image: Boolean for whether to take a full image.
         :param bins: Integer value for number of bins.
+        :param pipelined: Boolean for whether to expose the next image whilst the last is downloaded, oriented and
+                          written to disk, see self.stream_exposures(). Defaults to the "pipelined" config option.
         :return: Two parameters: Image list (numpy data or paths), Metadata list of MetaDataEntry objects.
         """
 
-        # Convert exposure time to contain units if not already a Pint quantity.
-        if type(exposure_time) is not quantity:
-            exposure_time = quantity(exposure_time, units.microsecond)
-
-        self.__setup_control_values(exposure_time, subarray_x=subarray_x, subarray_y=subarray_y, width=width,
-                                    height=height, gain=gain, full_image=full_image, bins=bins)
-
-        # Create metadata from extra_metadata input.
-        meta_data = [MetaDataEntry("Exposure Time", "EXP_TIME", exposure_time.to(units.microsecond).m, "microseconds")]
-        meta_data.append(MetaDataEntry("Camera", "CAMERA", self.config_id, "Camera model, correlates to entry in ini"))
-        meta_data.append(MetaDataEntry("Bins", "BINS", self.bins, "Binning for camera"))
-        if extra_metadata is not None:
-            if isinstance(extra_metadata, list):
-                meta_data.extend(extra_metadata)
-            else:
-                meta_data.append(extra_metadata)
+        exposure_time, meta_data = self.__prepare_exposures(exposure_time, extra_metadata=extra_metadata,
+                                                            subarray_x=subarray_x, subarray_y=subarray_y,
+                                                            width=width, height=height, gain=gain,
+                                                            full_image=full_image, bins=bins)
 
         # DATA MODE: Takes images and returns data and metadata (does not write anything to disk).
         img_list = []
         if not file_mode:
             # Take exposures and add to list.
-            for i in range(num_exposures):
-                img = self.__capture(exposure_time)
-                img_list.append(img)
+            img_list.extend(self.__capture_exposures(exposure_time, num_exposures, pipelined=pipelined))
             if return_metadata:
                 return img_list, meta_data
             else:
@@ -134,61 +168,61 @@ class SbigCamera(Camera):
         if not os.path.exists(path):
             os.makedirs(path)
 
-        # Take exposures. Use Astropy to handle fits format.
+        # For multiple exposures append frame number to end of base file name.
+        filenames = [file_root + "_frame" + str(i + 1) + file_ext if num_exposures > 1 else filename
+                     for i in range(num_exposures)]
+
+        # If Resume is enabled, skip the exposures whose files already exist on disk.
+        exists = [resume and os.path.isfile(os.path.join(path, filename)) for filename in filenames]
+
+        # Add testbed state metadata.
+        header = catkit.util.build_fits_header(meta_data)
+
+        # Take exposures. When pipelined, files are written in the background whilst the next exposures are taken.
+        pipelined = self.pipelined if pipelined is None else pipelined
         skip_counter = 0
-        for i in range(num_exposures):
-
-            # For multiple exposures append frame number to end of base file name.
-            if num_exposures > 1:
-                filename = file_root + "_frame" + str(i + 1) + file_ext
-            full_path = os.path.join(path, filename)
-
-            # If Resume is enabled, continue if the file already exists on disk.
-            if resume and os.path.isfile(full_path):
-                self.log.info("File already exists: " + full_path)
-                img_list.append(full_path)
-                continue
-
-            # Take exposure.
-            img = self.__capture(exposure_time)
-
-            # Skip writing the fits files per the raw_skip value, and keep img data in memory.
-            if raw_skip != 0:
-                img_list.append(img)
-                if skip_counter == (raw_skip + 1):
-                    skip_counter = 0
-                if skip_counter == 0:
-                    # Write fits.
-                    skip_counter += 1
-                elif skip_counter > 0:
-                    # Skip fits.
-                    skip_counter += 1
+        with contextlib.ExitStack() as stack:
+            images = stack.enter_context(contextlib.closing(
+                self.__capture_exposures(exposure_time, exists.count(False), pipelined=pipelined)))
+            writer = stack.enter_context(FitsWriterPool()) if pipelined else None
+            for i in range(num_exposures):
+                filename = filenames[i]
+                full_path = os.path.join(path, filename)
 
+                if exists[i]:
+                    self.log.info("File already exists: " + full_path)
+                    img_list.append(full_path)
                     continue
 
-            # Create a PrimaryHDU object to encapsulate the data.
-            hdu = fits.PrimaryHDU(img)
-
-            # Add headers.
-            hdu.header["FRAME"] = i + 1
-            hdu.header["FILENAME"] = filename
-
-            # Add testbed state metadata.
-            for entry in meta_data:
-                if len(entry.name_8chars) > 8:
-                    self.log.warning("Fits Header Keyword: " + entry.name_8chars +
-                          " is greater than 8 characters and will be truncated.")
-                if len(entry.comment) > 47:
-                    self.log.warning("Fits Header comment for " + entry.name_8chars +
-                          " is greater than 47 characters and will be truncated.")
-                hdu.header[entry.name_8chars[:8]] = (entry.value, entry.comment)
-
-            # Create a HDUList to contain the newly created primary HDU, and write to a new file.
-            fits.HDUList([hdu])
-            hdu.writeto(full_path, overwrite=True)
-            self.log.info("wrote " + full_path)
-            if raw_skip == 0:
-                img_list.append(full_path)
+                # Take exposure.
+                img = next(images)
+
+                # Skip writing the fits files per the raw_skip value, and keep img data in memory.
+                if raw_skip != 0:
+                    img_list.append(img)
+                    if skip_counter == (raw_skip + 1):
+                        skip_counter = 0
+                    if skip_counter == 0:
+                        # Write fits.
+                        skip_counter += 1
+                    elif skip_counter > 0:
+                        # Skip fits.
+                        skip_counter += 1
+
+                        continue
+
+                # Add headers.
+                frame_header = header.copy()
+                frame_header["FRAME"] = i + 1
+                frame_header["FILENAME"] = filename
+
+                if writer is not None:
+                    writer.write(img, frame_header, full_path)
+                else:
+                    fits.PrimaryHDU(img, header=frame_header).writeto(full_path, overwrite=True)
+                self.log.info("wrote " + full_path)
+                if raw_skip == 0:
+                    img_list.append(full_path)
 
         # If data mode, return meta_data with data.
         if return_metadata:
@@ -196,6 +230,55 @@ class SbigCamera(Camera):
         else:
             return img_list
 
+    def stream_exposures(self, exposure_time, num_exposures,
+                         extra_metadata=None,
+                         subarray_x=None, subarray_y=None, width=None, height=None, gain=None, full_image=None,
+                         bins=None, pipelined=None):
+        """
+        Take exposures and return them using a generator.
+        :param exposure_time: Pint quantity for exposure time, otherwise in microseconds.
+        :param num_exposures: Number of exposures.
+        :param extra_metadata: Will be appended to metadata created and written to fits header.
+        :param subarray_x: X coordinate of center pixel of the subarray.
+        :param subarray_y: Y coordinate of center pixel of the subarray.
+        :param width: Desired width of image.
+        :param height: Desired height of image.
+        :param gain: Gain is ignored for the SBIG camera; the API doesn't have a way to set gain.
+        :param full_image: Boolean for whether to take a full image.
+        :param bins: Integer value for number of bins.
+        :param pipelined: Boolean, if True, start each exposure as soon as the last image is ready and download &
+                          orient that on a worker thread whilst the next is exposed. The camera must keep serving the
+                          last image until the next exposure completes. Defaults to the "pipelined" config option.
+        :yield: Two parameters: Image (numpy data), Metadata list of MetaDataEntry objects.
+        """
+        exposure_time, meta_data = self.__prepare_exposures(exposure_time, extra_metadata=extra_metadata,
+                                                            subarray_x=subarray_x, subarray_y=subarray_y,
+                                                            width=width, height=height, gain=gain,
+                                                            full_image=full_image, bins=bins)
+        for image in self.__capture_exposures(exposure_time, num_exposures, pipelined=pipelined):
+            yield image, meta_data
+
+    def __prepare_exposures(self, exposure_time, extra_metadata=None, **kwargs):
+        """Applies the control values (see self.__setup_control_values()) and creates the metadata for exposures.
+           Returns the exposure time as a Pint quantity and the metadata list of MetaDataEntry objects."""
+
+        # Convert exposure time to contain units if not already a Pint quantity.
+        if type(exposure_time) is not quantity:
+            exposure_time = quantity(exposure_time, units.microsecond)
+
+        self.__setup_control_values(exposure_time, **kwargs)
+
+        # Create metadata from extra_metadata input.
+        meta_data = [MetaDataEntry("Exposure Time", "EXP_TIME", exposure_time.to(units.microsecond).m, "microseconds")]
+        meta_data.append(MetaDataEntry("Camera", "CAMERA", self.config_id, "Camera model, correlates to entry in ini"))
+        meta_data.append(MetaDataEntry("Bins", "BINS", self.bins, "Binning for camera"))
+        if extra_metadata is not None:
+            if isinstance(extra_metadata, list):
+                meta_data.extend(extra_metadata)
+            else:
+                meta_data.append(extra_metadata)
+        return exposure_time, meta_data
+
     def __setup_control_values(self, exposure_time, subarray_x=None, subarray_y=None, width=None, height=None,
                                gain=None, full_image=None, bins=None):
         """Applies control values found in the config.ini unless overrides are passed in, and does error checking.
@@ -203,38 +286,41 @@ class SbigCamera(Camera):
 
         self.log.info("Setting up control values")
         # Load values from config.ini into variables, and override with keyword args when applicable.
-        self.cooler_state = CONFIG_INI.getint(self.config_id, 'cooler_state')
-        self.subarray_x = subarray_x if subarray_x is not None else CONFIG_INI.getint(self.config_id, 'subarray_x')
-        self.subarray_y = subarray_y if subarray_y is not None else CONFIG_INI.getint(self.config_id, 'subarray_y')
-        self.width = width if width is not None else CONFIG_INI.getint(self.config_id, 'width')
-        self.height = height if height is not None else CONFIG_INI.getint(self.config_id, 'height')
-        self.full_image = full_image if full_image is not None else CONFIG_INI.getboolean(self.config_id, 'full_image')
-        self.bins = bins if bins is not None else CONFIG_INI.getint(self.config_id, 'bins')
+        self.subarray_x = subarray_x if subarray_x is not None else self.config_defaults['subarray_x']
+        self.subarray_y = subarray_y if subarray_y is not None else self.config_defaults['subarray_y']
+        self.width = width if width is not None else self.config_defaults['width']
+        self.height = height if height is not None else self.config_defaults['height']
+        self.full_image = full_image if full_image is not None else self.config_defaults['full_image']
+        self.bins = bins if bins is not None else self.config_defaults['bins']
         self.exposure_time = exposure_time if exposure_time is not None else CONFIG_INI.getfloat(self.config_id,
                                                                                                  'exposure_time')
 
         # Store the camera's detector shape.
-        detector_max_x = CONFIG_INI.getint(self.config_id, 'detector_width')
-        detector_max_y = CONFIG_INI.getint(self.config_id, 'detector_length')
+        detector_max_x = self.detector_width
+        detector_max_y = self.detector_length
 
         if self.full_image:
-            self.log.info("Taking full", detector_max_x, "x", detector_max_y, "image, ignoring region of interest params.")
+            self.log.info(f"Taking full {detector_max_x} x {detector_max_y} image, ignoring region of interest params.")
+            # Hardware binning isn't applied to full images, so bin them in software. The camera keeps the binning of
+            # earlier exposures though, so reset it.
             fi_params = {'StartX': '0', 'StartY': '0',
                          'NumX': str(detector_max_x), 'NumY': str(detector_max_y),
+                         'BinX': '1', 'BinY': '1',
                          'CoolerState': str(self.cooler_state)}
-            r = requests.get(self.base_url + "ImagerSetSettings.cgi", params=fi_params, timeout=self.timeout)
+            r = self.instrument.get(self.base_url + "ImagerSetSettings.cgi", params=fi_params, timeout=self.timeout)
             r.raise_for_status()
+            self.image_shape = (detector_max_x, detector_max_y)
+            self.software_bins = self.bins
             return
 
         # Check for errors, log before exiting.
         error_flag = False
 
         # Unlike ZWO, width and height are in camera pixels, unaffected by bins
-        if self.bins != 1:
-            # set the parameters for binning
-            bin_params = {'BinX': str(self.bins), 'BinY': str(self.bins)}
-            r = requests.get(self.base_url + "ImagerSetSettings.cgi", params=bin_params, timeout=self.timeout)
-            r.raise_for_status()
+        # Set the binning even if 1, as the camera keeps that of earlier exposures.
+        bin_params = {'BinX': str(self.bins), 'BinY': str(self.bins)}
+        r = self.instrument.get(self.base_url + "ImagerSetSettings.cgi", params=bin_params, timeout=self.timeout)
+        r.raise_for_status()
 
         # Derive the start x/y position of the region of interest, and check that it falls on the detector.
         derived_start_x = self.subarray_x - (self.width // 2)
@@ -263,7 +349,7 @@ class SbigCamera(Camera):
             fi_params = {'StartX': '0', 'StartY': '0',
                          'NumX': str(detector_max_x), 'NumY': str(detector_max_y),
                          'CoolerState': '0'}
-            r = requests.get(self.base_url + "ImagerSetSettings.cgi", params=fi_params, timeout=self.timeout)
+            r = self.instrument.get(self.base_url + "ImagerSetSettings.cgi", params=fi_params, timeout=self.timeout)
             r.raise_for_status()
         else:
             if error_flag:
@@ -274,14 +360,16 @@ class SbigCamera(Camera):
             roi_params = {'StartX': str(derived_start_x), 'StartY': str(derived_start_y),
                           'NumX': str(self.width), 'NumY': str(self.height),
                           'CoolerState': str(self.cooler_state)}
-            r = requests.get(self.base_url + "ImagerSetSettings.cgi", params=roi_params, timeout=self.timeout)
+            r = self.instrument.get(self.base_url + "ImagerSetSettings.cgi", params=roi_params, timeout=self.timeout)
             r.raise_for_status()
+        self.image_shape = (self.width // self.bins, self.height // self.bins)
+        self.software_bins = 1
 
     def __check_imager_state(self):
         """Utility function to get the current state of the camera.
            Make an HTTP request and check for good response, then return the value of the response.
            Will raise an exception on an HTTP failure."""
-        r = requests.get(self.base_url + "ImagerState.cgi", timeout=self.timeout)
+        r = self.instrument.get(self.base_url + "ImagerState.cgi", timeout=self.timeout)
         r.raise_for_status()
         return int(r.text)
 
@@ -289,7 +377,7 @@ class SbigCamera(Camera):
         """Utility function to check that the camera is ready to expose.
            Make an HTTP request and check for good response, then return the value of hte response.
            Will raise an exception on an HTTP failure."""
-        r = requests.get(self.base_url + "ImagerImageReady.cgi", timeout=self.timeout)
+        r = self.instrument.get(self.base_url + "ImagerImageReady.cgi", timeout=self.timeout)
         r.raise_for_status()
         return int(r.text)
 
@@ -299,37 +387,143 @@ class SbigCamera(Camera):
            Assumes the parameters for the exposure are already set."""
 
         # start an exposure.
+        self.__start_exposure(exposure_time)
+
+        # wait until imager has taken an image
+        self.__wait_for_exposure(exposure_time.to(units.second).magnitude)
+
+        # at loop exit, the image should be available
+        self.__verify_image_available()
+
+        # get the image
+        return self.__download_and_orient()
+
+    def __capture_exposures(self, exposure_time, num_exposures, pipelined=None):
+        """Utility generator taking a number of images, one after the other or pipelined (see self.stream_exposures()).
+           Assumes the parameters for the exposures are already set."""
+        pipelined = self.pipelined if pipelined is None else pipelined
+        if pipelined:
+            yield from self.__capture_pipelined(exposure_time, num_exposures)
+        else:
+            for i in range(num_exposures):
+                yield self.__capture(exposure_time)
+
+    def __capture_pipelined(self, exposure_time, num_exposures):
+        """Utility generator taking a number of images, starting each exposure as soon as the last image is ready.
+           The last image is then downloaded and oriented on a worker thread, with an HTTP session of its own, whilst
+           the next is exposed, and yielded once that exposure was started, such that the consumer's processing
+           overlaps with it too. The camera must keep serving the last image until the next exposure completes."""
+        if num_exposures < 1:
+            return
+
+        exposure_time_in_seconds = exposure_time.to(units.second).magnitude
+        session = self.instrument_lib.Session()
+        exposing = False
+        try:
+            with concurrent.futures.ThreadPoolExecutor(max_workers=1) as executor:
+                self.__start_exposure(exposure_time)
+                exposing = True
+                download = None
+                for i in range(num_exposures):
+                    self.__wait_for_exposure(exposure_time_in_seconds)
+                    exposing = False
+                    if download is not None and not download.done():
+                        self.log.warning("The image download took longer than the next exposure, which may have "
+                                         "overwritten the image.")
+                    image = None if download is None else download.result()
+                    self.__verify_image_available()
+
+                    if i + 1 < num_exposures:
+                        self.__start_exposure(exposure_time)
+                        exposing = True
+                    download = executor.submit(self.__download_and_orient, session)
+
+                    if image is not None:
+                        yield image
+                yield download.result()
+        finally:
+            if exposing:
+                # The consumer stopped early.
+                self.__abort_exposure()
+            session.close()
+
+    def __start_exposure(self, exposure_time):
+        """Utility function to start an exposure. Will raise an exception on an HTTP failure."""
         params = {'Duration': exposure_time.to(units.second).magnitude,
                   'FrameType': self.FRAME_TYPE_LIGHT}
-        r = requests.get(self.base_url + "ImagerStartExposure.cgi",
-                         params=params,
-                         timeout=self.timeout)
+        r = self.instrument.get(self.base_url + "ImagerStartExposure.cgi",
+                                params=params,
+                                timeout=self.timeout)
         r.raise_for_status()
-        imager_state = self.IMAGER_STATE_EXPOSING
 
-        # wait until imager has taken an image
-        while imager_state > self.IMAGER_STATE_IDLE:
-            catkit.util.sleep(self.min_delay)  # limit the rate at which requests go to the camera
-            imager_state = self.__check_imager_state()
-            if imager_state == self.IMAGER_STATE_ERROR:
-                # an error has occurred
-                self.log.error('Imager error during exposure')
-                raise Exception("Camera reported error during exposure.")
+    def __abort_exposure(self):
+        """Utility function to abort the exposure in progress. Will raise an exception on an HTTP failure."""
+        catkit.util.sleep(self.min_delay)  # limit the rate at which requests go to the camera
+        r = self.instrument.get(self.base_url + "ImagerAbortExposure.cgi", timeout=self.timeout)
+        # no data is returned, but an http error indicates if the abort failed
+        r.raise_for_status()
 
-        # at loop exit, the image should be available
+    def __verify_image_available(self):
+        """Utility function to check that the image of the last exposure is available for download."""
         image_status = self.__check_image_status()
         if image_status != self.IMAGE_AVAILABLE:
             self.log.error('No image after exposure')
             raise Exception("Camera reported no image available after exposure.")
 
-        # get the image
-        r = requests.get(self.base_url + "ImagerData.bin", timeout=self.timeout)
-        r.raise_for_status()
-        image = np.reshape(np.frombuffer(r.content, np.uint16), (self.width // self.bins, self.height // self.bins))
+    def __download_and_orient(self, session=None):
+        """Utility function to download the image (see self.__download_image()) and apply rotation and flip to it based
+           on config.ini file, converting to float32 in the same pass. This copies the image out of self.image_buffer,
+           which can thus be reused for the next one. Images are binned first if hardware binning wasn't applied."""
+        image = self.__download_image(session)
+        if self.software_bins != 1:
+            image = catkit.util.bin_image(image, self.software_bins)
+        return catkit.util.orient_image(image, self.theta, self.fliplr)
+
+    def __wait_for_exposure(self, exposure_time):
+        """Utility function to wait until the imager is idle again, i.e., has taken and read out the image.
+           Rather than polling throughout, sleep for the exposure time and the readout time measured for the last
+           exposure, then poll at the rate limit (min_delay). Will raise an exception if the imager reports an error."""
+        start = time.monotonic()
+        catkit.util.sleep(max(exposure_time + self.readout_time - self.min_delay, 0))
 
-        # Apply rotation and flip to the image based on config.ini file.
-        theta = CONFIG_INI.getint(self.config_id, 'image_rotation')
-        fliplr = CONFIG_INI.getboolean(self.config_id, 'image_fliplr')
-        image = catkit.util.rotate_and_flip_image(image, theta, fliplr)
+        imager_state = self.IMAGER_STATE_EXPOSING
+        polls = 0
+        while imager_state > self.IMAGER_STATE_IDLE:
+            catkit.util.sleep(self.min_delay)  # limit the rate at which requests go to the camera
+            imager_state = self.__check_imager_state()
+            polls += 1
+            if imager_state == self.IMAGER_STATE_ERROR:
+                # an error has occurred
+                self.log.error('Imager error during exposure')
+                raise Exception("Camera reported error during exposure.")
 
-        return image
+        if polls > 1:
+            self.readout_time = max(time.monotonic() - start - exposure_time, 0)
+        else:
+            # Idle at the first poll, i.e., the readout ended whilst sleeping, such that the time taken only bounds it
+            # from above (and would only ever grow the estimate). Shorten it instead, to measure it again by polling.
+            self.readout_time *= self.readout_time_decay
+
+    def __download_image(self, session=None):
+        """Utility function to download the image, streamed into self.image_buffer (reused for images of the same size)
+           rather than buffering the whole response. Returns the (raw, uint16 and unoriented) image as a view of
+           self.image_buffer, valid until the next download. Uses the given requests.Session, defaults to
+           self.instrument. Will raise an exception on an HTTP failure."""
+        session = self.instrument if session is None else session
+        nbytes = int(np.prod(self.image_shape)) * np.dtype(np.uint16).itemsize
+        if self.image_buffer is None or len(self.image_buffer) != nbytes:
+            self.image_buffer = bytearray(nbytes)
+
+        buffer = memoryview(self.image_buffer)
+        size = 0
+        with session.get(self.base_url + "ImagerData.bin", stream=True, timeout=self.timeout) as r:
+            r.raise_for_status()
+            for chunk in r.iter_content(chunk_size=self.download_chunk_size):
+                if size + len(chunk) > nbytes:
+                    raise RuntimeError(f"Expected an image of {nbytes} bytes but got more.")
+                buffer[size:size + len(chunk)] = chunk
+                size += len(chunk)
+        if size != nbytes:
+            raise RuntimeError(f"Expected an image of {nbytes} bytes but got {size}.")
+
+        return np.frombuffer(self.image_buffer, np.uint16).reshape(self.image_shape)
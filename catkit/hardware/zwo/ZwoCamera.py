@@ -1,12 +1,19 @@
+import contextlib
 import os
 import sys
+import time
 
 import numpy as np
 import zwoasi
 
 from catkit.config import CONFIG_INI
 
+from catkit.acquisition import BackgroundAcquisition, Frame, FrameInfo, FrameRingBuffer, StreamStatistics, \
+    create_reducer
+from catkit.calibration import CalibrationCache, CalibrationKey
 from catkit.catkit_types import MetaDataEntry, units, quantity
+from catkit import datalogging
+from catkit.fits_writer import FitsWriterPool
 from catkit.interfaces.Camera import Camera
 import catkit.util
 
@@ -19,6 +26,10 @@ class ZwoCamera(Camera):
     instrument_lib = zwoasi
     __ZWO_ASI_LIB = 'ZWO_ASI_LIB'
 
+    data_log = datalogging.get_logger(__name__)
+    # How often (seconds) the statistics of a running stream are logged to the data log, see stream_exposures().
+    stream_statistics_log_interval = 10
+
     @classmethod
     def load_asi_lib(cls):
         # Importing zwoasi doesn't hook it up to the backend driver, we have to unfortunately do this.
@@ -46,8 +57,13 @@ class ZwoCamera(Camera):
         except Exception as error:
             raise ImportError(f"Failed to load {cls.__ZWO_ASI_LIB} library backend to {cls.instrument_lib.__qualname__}") from error
 
-    def initialize(self):
-        """Uses the config_id to look up parameters in the config.ini."""
+    def initialize(self, num_frame_buffers=4, calibration=None):
+        """Uses the config_id to look up parameters in the config.ini.
+
+        :param num_frame_buffers: Number of preallocated frames that video capture cycles through.
+        :param calibration: catkit.calibration.CalibrationCache, or the directory to persist one to, holding master
+                            darks & biases. Defaults to one in memory only. See Camera.take_master_calibration().
+        """
 
         # Importing zwoasi doesn't hook it up to the backend driver, we have to unfortunately do this.
         self.load_asi_lib()
@@ -56,6 +72,22 @@ class ZwoCamera(Camera):
         self.theta = CONFIG_INI.getint(self.config_id, 'image_rotation')
         self.fliplr = CONFIG_INI.getboolean(self.config_id, 'image_fliplr')
 
+        # Video frames are captured into a ring of preallocated buffers, allocated upon the first video capture.
+        self.num_frame_buffers = num_frame_buffers
+        self.frame_ring = None
+        self.frame_ring_roi = None
+
+        # Number of frames dropped by the last background stream, see stream_exposures().
+        self.dropped_frames = 0
+        # catkit.acquisition.StreamStatistics of the current (or last) stream, see stream_exposures().
+        self.stream_statistics = None
+
+        # The control values & ROI last applied to the camera, such that only changes are sent. See
+        # self.invalidate_control_state().
+        self.invalidate_control_state()
+
+        self.calibration = calibration if isinstance(calibration, CalibrationCache) else CalibrationCache(calibration)
+
     def _open(self):
 
         # Attempt to find USB camera.
@@ -101,6 +133,9 @@ class ZwoCamera(Camera):
         # Set image format to be RAW16, although camera is only 12-bit.
         self.instrument.set_image_type(self.instrument_lib.ASI_IMG_RAW16)
 
+        # All controls were just reset.
+        self.invalidate_control_state()
+
         return self.instrument
 
     def __capture(self, initial_sleep):
@@ -115,8 +150,8 @@ class ZwoCamera(Camera):
 
         Returns
         -------
-        image : np.array of floats
-            Array of floats making up the image.
+        image : np.array
+            The raw (uint16 and unoriented) image.
         """
 
         # Passing the initial_sleep and poll values prevent crashes. DO NOT REMOVE!!!
@@ -129,9 +164,9 @@ class ZwoCamera(Camera):
             if error.exposure_status == 3:
                 raise RuntimeError("Exposure error: camera already in use, please close all other uses, e.g., SharpCap.") from error
             raise RuntimeError(f"Exposure status: {error.exposure_status}") from error
-        return image.astype(np.dtype(np.float32))
+        return image
 
-    def __capture_and_orient(self, initial_sleep, theta, fliplr):
+    def __capture_and_orient(self, initial_sleep, theta, fliplr, dark=None):
         """ Takes an image and flips according to theta and l/r input.
 
         WARNING: This func does NOT set the exposure time!
@@ -144,52 +179,99 @@ class ZwoCamera(Camera):
             How many degrees to rotate the image.
         fliplr : bool
             Whether to flip left/right.
+        dark : np.array, optional
+            Dark (or bias) to subtract from the oriented image.
 
         Returns
         -------
         image : np.array of floats
             Array of floats making up the image.
+        timestamp : float
+            time.monotonic() just after capture.
         """
 
         unflipped_image = self.__capture(initial_sleep=initial_sleep)
-        image = catkit.util.rotate_and_flip_image(unflipped_image, theta, fliplr)
-        return image
+        timestamp = time.monotonic()
+        return catkit.util.orient_image(unflipped_image, theta, fliplr, dark=dark), timestamp
 
-    def __capture_video(self, num_exposures, timeout):
+    def __capture_video(self, num_exposures, timeout, num_frame_buffers=None, wait_for_free_buffer=False):
         """ Take a number of images.
 
         WARNING: This func does NOT set the exposure time!
 
+        Frames are captured directly into the slots of self.frame_ring, without intermediate copies. The consumer
+        MUST release each frame once done with it, otherwise capture stalls once all slots are in use.
+
         Parameters
         ----------
         num_exposures : int
             The number of exposures to take.
         timeout : Pint quantity
             How long to wait for an image. Afterwards a timeout exception is raised.
+        num_frame_buffers : int, optional
+            Minimum number of slots in the frame ring. Defaults to self.num_frame_buffers.
+        wait_for_free_buffer : bool
+            Whether to wait (up to timeout) for a consumer on another thread to release a frame when all slots are in
+            use, rather than raising immediately.
 
         Yields
         -------
-        image : np.array of floats
-            Each of the captured images.
+        frame : catkit.acquisition.Frame
+            Each of the captured (raw, uint16 and unoriented) images, along with its catkit.acquisition.FrameInfo.
         """
         timeout_in_ms = timeout.to(units.millisecond).magnitude
-        images = []
+        num_frame_buffers = max(num_frame_buffers or 0, self.num_frame_buffers)
+        if self.frame_ring is not None and self.frame_ring.num_slots < num_frame_buffers:
+            self.frame_ring = None
+        # None := non-blocking.
+        acquire_timeout = timeout.to(units.second).magnitude if wait_for_free_buffer else None
 
         self.instrument.start_video_capture()
+        # The SDK only resets its count of dropped frames when stopping capture.
+        dropped_offset = self.__get_dropped_frames()
 
         try:
             for i in range(num_exposures):
-                img = self.instrument.capture_video_frame(timeout=timeout_in_ms)
-                img = img.astype(np.dtype(np.float32))
-
-                yield img
+                frame = self.__capture_video_frame(timeout_in_ms, num_frame_buffers, acquire_timeout)
+                dropped = self.__get_dropped_frames()
+                frame.info = FrameInfo(sequence=i, timestamp=time.monotonic(),
+                                       dropped=None if dropped is None else dropped - dropped_offset)
+                yield frame
         finally:
             # Stop exposures. The stop_exposure() might not be necessary, but there's no
             # harm in calling it anyway.
             self.instrument.stop_video_capture()
             self.instrument.stop_exposure()
 
-    def __capture_video_and_orient(self, num_exposures, timeout, theta, fliplr):
+    def __capture_video_frame(self, timeout_in_ms, num_frame_buffers, acquire_timeout=None):
+        """ Capture a single video frame into a free slot of self.frame_ring. """
+
+        if self.frame_ring is None:
+            # Let the SDK size the first frame and allocate the ring from it.
+            image = self.instrument.capture_video_frame(timeout=timeout_in_ms)
+            self.frame_ring = FrameRingBuffer(image.shape, image.dtype, num_slots=num_frame_buffers)
+            frame = self.frame_ring.acquire(block=False)
+        else:
+            frame = self.frame_ring.acquire(block=acquire_timeout is not None, timeout=acquire_timeout)
+            # NOTE: The buffer is passed positionally as zwoasi names this arg ``buffer_``.
+            image = self.instrument.capture_video_frame(frame.buffer, timeout=timeout_in_ms)
+
+        if not np.may_share_memory(image, frame.data):
+            # The first frame and emulators don't capture into the given buffer.
+            if not self.frame_ring.matches(image.shape, image.dtype):
+                frame.release()
+                self.frame_ring = FrameRingBuffer(image.shape, image.dtype, num_slots=num_frame_buffers)
+                frame = self.frame_ring.acquire(block=False)
+            frame.data[...] = image
+
+        return frame
+
+    def __get_dropped_frames(self):
+        """ The SDK's count of frames dropped by video capture, None if the driver doesn't provide it. """
+        get_dropped_frames = getattr(self.instrument, "get_dropped_frames", None)
+        return None if get_dropped_frames is None else get_dropped_frames()
+
+    def __capture_video_and_orient(self, num_exposures, timeout, theta, fliplr, dark=None, **kwargs):
         """ Takes a number of images and flips each according to theta and l/r input.
 
         WARNING: This func does NOT set the exposure time!
@@ -204,14 +286,39 @@ class ZwoCamera(Camera):
             How many degrees to rotate the image.
         fliplr : bool
             Whether to flip left/right.
+        dark : np.array, optional
+            Dark (or bias) to subtract from each oriented image.
+        kwargs :
+            Passed to self.__capture_video().
+
+        Yields
+        -------
+        image : np.array of floats
+            Each captured image.
+        info : catkit.acquisition.FrameInfo
+            Of each captured image.
+        """
+        for frame in self.__capture_video(num_exposures, timeout, **kwargs):
+            with frame:
+                # Convert, orient (and subtract the dark) in a single pass out of the ring, after which the slot can be
+                # reused.
+                image = catkit.util.orient_image(frame.data, theta, fliplr, dark=dark)
+            yield image, frame.info
+
+    def __capture_snapshots_and_orient(self, num_exposures, initial_sleep, theta, fliplr, dark=None):
+        """ Takes a number of images in snapshot mode, see self.__capture_and_orient().
 
         Yields
         -------
         image : np.array of floats
             Each captured image.
+        info : catkit.acquisition.FrameInfo
+            Of each captured image.
         """
-        for img in self.__capture_video(num_exposures, timeout):
-            yield catkit.util.rotate_and_flip_image(img, theta, fliplr)
+        for i in range(num_exposures):
+            image, timestamp = self.__capture_and_orient(initial_sleep=initial_sleep, theta=theta, fliplr=fliplr,
+                                                         dark=dark)
+            yield image, FrameInfo(sequence=i, timestamp=timestamp, dropped=None)
 
     def _close(self):
         """Close camera connection"""
@@ -223,19 +330,50 @@ class ZwoCamera(Camera):
                        extra_metadata=None,
                        return_metadata=False,
                        subarray_x=None, subarray_y=None, width=None, height=None, gain=None, full_image=None,
-                       bins=None):
-        """ Wrapper to take exposures and also save them if `file_mode` is used. """
-
-        images, meta = self.just_take_exposures(exposure_time=exposure_time,
-                                                num_exposures=num_exposures,
-                                                extra_metadata=extra_metadata,
-                                                full_image=full_image, subarray_x=subarray_x, subarray_y=subarray_y,
-                                                width=width, height=height,
-                                                gain=gain,
-                                                bins=bins)
+                       bins=None, reduce=None, writer=None, cube_mode=False, subtract=None):
+        """ Wrapper to take exposures and also save them if `file_mode` is used.
+
+        Files are written in the background, by `writer` (a catkit.fits_writer.FitsWriterPool) if given, in which case
+        the caller is responsible to flush it, otherwise by a pool of its own that is flushed before returning.
+
+        :param reduce: If given, return the reduction ("mean", "sum", "median-approx" or "mean+var") of the exposures,
+                       accumulated as they stream, rather than the list of all of them. See self.reduce_exposures().
+        :param cube_mode: If True, `file_mode` writes the exposures into a single file, as a cube, rather than a file
+                          per exposure. See Camera.save_stream().
+        :param subtract: "dark" or "bias" to subtract the corresponding master from each exposure, see
+                         self.stream_exposures().
+        """
 
-        if file_mode:
-            catkit.util.save_images(images, meta, path=path, base_filename=filename, raw_skip=raw_skip)
+        stream_kwargs = dict(extra_metadata=extra_metadata,
+                             full_image=full_image, subarray_x=subarray_x, subarray_y=subarray_y,
+                             width=width, height=height,
+                             gain=gain,
+                             bins=bins,
+                             subtract=subtract)
+
+        if reduce is not None:
+            images, meta = self.reduce_exposures(exposure_time=exposure_time,
+                                                 num_exposures=num_exposures,
+                                                 reduce=reduce,
+                                                 file_mode=file_mode, raw_skip=raw_skip, path=path, filename=filename,
+                                                 writer=writer, cube_mode=cube_mode,
+                                                 **stream_kwargs)
+        elif file_mode:
+            # Write frames as they stream, such that writing overlaps with acquisition.
+            images = []
+            meta = None
+            with contextlib.ExitStack() as stack:
+                if writer is None and not cube_mode:
+                    writer = stack.enter_context(FitsWriterPool())
+                stream = self.stream_exposures(exposure_time=exposure_time, num_exposures=num_exposures,
+                                               frame_info=True, **stream_kwargs)
+                for img, meta, _info in self.save_stream(stream, num_exposures, path, filename, raw_skip=raw_skip,
+                                                         writer=writer, cube_mode=cube_mode):
+                    images.append(img)
+        else:
+            images, meta = self.just_take_exposures(exposure_time=exposure_time,
+                                                    num_exposures=num_exposures,
+                                                    **stream_kwargs)
 
         # TODO: Nuke this and always return both, eventually returning a HDUList (HICAT-794).
         if return_metadata:
@@ -243,10 +381,44 @@ class ZwoCamera(Camera):
         else:
             return images
 
+    def reduce_exposures(self, exposure_time, num_exposures, reduce="mean",
+                         file_mode=False, raw_skip=0, path=None, filename=None, writer=None, cube_mode=False,
+                         use_video_capture_mode=True, **kwargs):
+        """ See Camera.reduce_exposures().
+
+        Unless frames are written to disk or calibrated (and thus oriented individually anyway), video frames are
+        reduced straight from the frame ring and only the result gets oriented.
+        """
+
+        if file_mode or not use_video_capture_mode or kwargs.get("subtract"):
+            # With the FrameInfos, such that cubes are written with the capture time of each frame.
+            return super().reduce_exposures(exposure_time, num_exposures, reduce=reduce,
+                                            file_mode=file_mode, raw_skip=raw_skip, path=path, filename=filename,
+                                            writer=writer, cube_mode=cube_mode,
+                                            use_video_capture_mode=use_video_capture_mode, frame_info=True, **kwargs)
+
+        reducer = create_reducer(reduce)
+        meta_data = None
+        for frame, meta_data in self.stream_exposures(exposure_time, num_exposures, raw_frames=True, **kwargs):
+            with frame:
+                reducer.add(frame.data)
+
+        result = reducer.result()
+        if isinstance(result, tuple):
+            result = tuple(self.__orient(image) for image in result)
+        else:
+            result = self.__orient(result)
+        return result, meta_data
+
+    def __orient(self, image):
+        return catkit.util.orient_image(image, self.theta, self.fliplr, dtype=image.dtype)
+
     def stream_exposures(self, exposure_time, num_exposures,
                          extra_metadata=None,
                          subarray_x=None, subarray_y=None, width=None, height=None, gain=None, full_image=None,
-                         bins=None, use_video_capture_mode=True):
+                         bins=None, use_video_capture_mode=True, raw_frames=False,
+                         background=False, queue_size=8, backpressure=BackgroundAcquisition.BLOCK, subtract=None,
+                         frame_info=False):
         """
         Take exposures and return them using a generator.
 
@@ -261,9 +433,37 @@ class ZwoCamera(Camera):
         :param full_image: Boolean for whether to take a full image.
         :param bins: Integer value for number of bins.
         :param use_video_capture_mode: Boolean for whether to use video capture or snapshot mode. Default is True.
-        :yield: Two parameters: Image (numpy data), Metadata list of MetaDataEntry objects.
+        :param raw_frames: Boolean, if True, yield the catkit.acquisition.Frame objects that video frames are captured
+                           into, rather than oriented float copies. Their data are views of the raw (uint16 and
+                           unoriented, see self.theta & self.fliplr) images. Each frame MUST be released by the caller
+                           once done with it. Requires use_video_capture_mode.
+        :param background: Boolean, if True, capture on a producer thread into a queue, such that capture continues
+                           while the caller processes the yielded frames. The camera must not otherwise be used until
+                           the stream is exhausted or closed.
+        :param queue_size: Maximum number of frames queued when background is True.
+        :param backpressure: What to do when background is True and the queue is full: "block" pauses capture,
+                             "drop_oldest" discards the oldest queued frame, counted in self.dropped_frames.
+        :param subtract: "dark" or "bias" to subtract the master dark/bias taken with the same settings (see
+                         Camera.take_master_calibration()) from each image, in the same pass as orienting it.
+        :param frame_info: Boolean, if True, also yield the catkit.acquisition.FrameInfo (capture time, sequence number &
+                           the driver's count of dropped frames) of each image. Raw frames carry it as Frame.info too.
+        :yield: Two parameters: Image (numpy data), Metadata list of MetaDataEntry objects. Three if `frame_info`.
+
+        The rate, latency (from capture until yielded) and drops of the stream are kept in self.stream_statistics and
+        logged to the data log under "<config_id>/stream", every self.stream_statistics_log_interval seconds and once
+        the stream ends.
         """
 
+        if raw_frames and not use_video_capture_mode:
+            raise ValueError("raw_frames requires use_video_capture_mode=True.")
+        if raw_frames and subtract:
+            raise ValueError("Calibration frames can't be subtracted from raw_frames.")
+
+        dark = None
+        if subtract:
+            dark = self.get_master_calibration(subtract, exposure_time, subarray_x=subarray_x, subarray_y=subarray_y,
+                                               width=width, height=height, gain=gain, full_image=full_image, bins=bins)
+
         # Convert exposure time to contain units if not already a Pint quantity.
         # if not isintance(quantity):
         if type(exposure_time) is int or type(exposure_time) is float:
@@ -279,6 +479,8 @@ class ZwoCamera(Camera):
         meta_data.append(MetaDataEntry("Camera", "CAMERA", self.config_id, "Camera model, correlates to entry in ini"))
         meta_data.append(MetaDataEntry("Gain", "GAIN", self.gain, "Gain for camera"))
         meta_data.append(MetaDataEntry("Bins", "BINS", self.bins, "Binning for camera"))
+        if subtract:
+            meta_data.append(MetaDataEntry("Subtracted", "CALSUB", subtract, "Master calibration frame subtracted"))
         if extra_metadata is not None:
             if isinstance(extra_metadata, list):
                 meta_data.extend(extra_metadata)
@@ -292,20 +494,63 @@ class ZwoCamera(Camera):
             # SDK recommends 2 x exposure time + 0.5sec, but we want to never trigger the timeout accidentally.
             timeout = 2 * exposure_time + quantity(10, units.second) # ms
 
-            for img in self.__capture_video_and_orient(num_exposures, timeout, theta=self.theta, fliplr=self.fliplr):
-                yield img, meta_data
+            # In the background, the ring has to hold the queued frames + that held by the consumer + that being captured.
+            capture_kwargs = dict(num_frame_buffers=queue_size + 2, wait_for_free_buffer=True) if background else {}
+            if raw_frames:
+                frames = self.__capture_video(num_exposures, timeout, **capture_kwargs)
+            else:
+                frames = self.__capture_video_and_orient(num_exposures, timeout, theta=self.theta, fliplr=self.fliplr,
+                                                         dark=dark, **capture_kwargs)
         else:
-            # Take exposures and add to list.
-            for i in range(num_exposures):
-                img = self.__capture_and_orient(initial_sleep=exposure_time, theta=self.theta, fliplr=self.fliplr)
+            frames = self.__capture_snapshots_and_orient(num_exposures, initial_sleep=exposure_time, theta=self.theta,
+                                                         fliplr=self.fliplr, dark=dark)
 
-                yield img, meta_data
+        if background:
+            on_discard = Frame.release if raw_frames else None
+            frames = BackgroundAcquisition(frames, maxsize=queue_size, backpressure=backpressure, on_discard=on_discard)
+
+        self.dropped_frames = 0
+        self.stream_statistics = StreamStatistics()
+        statistics_tag = f"{self.config_id}/stream"
+        last_logged = time.monotonic()
+        try:
+            for item in frames:
+                img, info = (item, item.info) if raw_frames else item
+                self.stream_statistics.add(info)
+                if info.timestamp - last_logged >= self.stream_statistics_log_interval:
+                    self.stream_statistics.log(self.data_log, statistics_tag)
+                    last_logged = info.timestamp
+                yield (img, meta_data, info) if frame_info else (img, meta_data)
+        finally:
+            if background:
+                frames.stop()
+                self.dropped_frames = frames.dropped_frames
+                if self.dropped_frames:
+                    self.log.warning(f"Dropped {self.dropped_frames} frames as they were not consumed fast enough.")
+            if self.stream_statistics.num_frames:
+                self.stream_statistics.log(self.data_log, statistics_tag)
+                if self.stream_statistics.driver_dropped_frames:
+                    self.log.warning(f"The camera dropped {self.stream_statistics.driver_dropped_frames} frames.")
 
     def just_take_exposures(self, exposure_time, num_exposures,
                             extra_metadata=None,
                             subarray_x=None, subarray_y=None, width=None, height=None, gain=None, full_image=None,
-                            bins=None, use_video_capture_mode=True):
-        """ Takes images and stores them in a list. """
+                            bins=None, use_video_capture_mode=True, reduce=None, subtract=None):
+        """ Takes images and stores them in a list, or, if `reduce` is given, returns their reduction instead. See
+        self.reduce_exposures() and, for `subtract`, self.stream_exposures(). """
+
+        if reduce is not None:
+            return self.reduce_exposures(exposure_time=exposure_time,
+                                         num_exposures=num_exposures,
+                                         reduce=reduce,
+                                         extra_metadata=extra_metadata,
+                                         full_image=full_image, subarray_x=subarray_x, subarray_y=subarray_y,
+                                         width=width, height=height,
+                                         gain=gain,
+                                         bins=bins,
+                                         use_video_capture_mode=use_video_capture_mode,
+                                         subtract=subtract)
+
         images = []
         metadata = None
 
@@ -316,7 +561,8 @@ class ZwoCamera(Camera):
                                                width=width, height=height,
                                                gain=gain,
                                                bins=bins,
-                                               use_video_capture_mode=use_video_capture_mode):
+                                               use_video_capture_mode=use_video_capture_mode,
+                                               subtract=subtract):
             images.append(img)
             metadata = meta
 
@@ -335,39 +581,109 @@ class ZwoCamera(Camera):
         self.log.info("Before Flash:")
         self.log.info(camera_info_before["Name"])
         self.instrument.set_id(0, new_id)
+        self.invalidate_control_state()
         self.log.info("After Flash:")
         camera_info_after = self.instrument.get_camera_property()
         self.log.info(camera_info_after["Name"])
 
+    def invalidate_control_state(self):
+        """ Forget the control values, ROI and config defaults last applied, such that the next exposures apply them all
+        afresh. Call this if anything else may have changed the camera's controls, or if the config has changed. """
+        self._applied_controls = {}
+        self._applied_roi = None
+        self._applied_setup = None
+        self._camera_property = None
+        self._config_defaults = None
+
+    def __get_config_defaults(self):
+        if self._config_defaults is None:
+            self._config_defaults = dict(subarray_x=CONFIG_INI.getint(self.config_id, 'subarray_x'),
+                                         subarray_y=CONFIG_INI.getint(self.config_id, 'subarray_y'),
+                                         width=CONFIG_INI.getint(self.config_id, 'width'),
+                                         height=CONFIG_INI.getint(self.config_id, 'height'),
+                                         gain=CONFIG_INI.getint(self.config_id, 'gain'),
+                                         full_image=CONFIG_INI.getboolean(self.config_id, 'full_image'),
+                                         bins=CONFIG_INI.getint(self.config_id, 'bins'))
+        return self._config_defaults
+
+    def __set_control_value(self, control_type, value):
+        """ Set a control value, unless that is the value last set. """
+        if self._applied_controls.get(control_type) != value:
+            self.instrument.set_control_value(control_type, value)
+            self._applied_controls[control_type] = value
+
+    def __get_camera_property(self):
+        if self._camera_property is None:
+            self._camera_property = self.instrument.get_camera_property()
+        return self._camera_property
+
+    def __resolve_setup(self, exposure_time, subarray_x=None, subarray_y=None, width=None, height=None, gain=None,
+                        full_image=None, bins=None):
+        """ The settings to use, i.e., those passed in or else those found in the config.ini. """
+
+        # Convert exposure time to contain units if not already a Pint quantity.
+        if type(exposure_time) is int or type(exposure_time) is float:
+            exposure_time = quantity(exposure_time, units.microsecond)
+
+        # Load values from config.ini into variables, and override with keyword args when applicable.
+        defaults = self.__get_config_defaults()
+        subarray_x = subarray_x if subarray_x is not None else defaults['subarray_x']
+        subarray_y = subarray_y if subarray_y is not None else defaults['subarray_y']
+        width = width if width is not None else defaults['width']
+        height = height if height is not None else defaults['height']
+        gain = gain if gain is not None else defaults['gain']
+        full_image = full_image if full_image is not None else defaults['full_image']
+        bins = bins if bins is not None else defaults['bins']
+        exposure_time_us = int(exposure_time.to(units.microsecond).magnitude)
+        return exposure_time_us, gain, full_image, subarray_x, subarray_y, width, height, bins
+
+    def calibration_key(self, exposure_time, subarray_x=None, subarray_y=None, width=None, height=None, gain=None,
+                        full_image=None, bins=None, **kwargs):
+        """ See Camera.calibration_key(). """
+        exposure_time_us, gain, full_image, subarray_x, subarray_y, width, height, bins = \
+            self.__resolve_setup(exposure_time, subarray_x=subarray_x, subarray_y=subarray_y, width=width,
+                                 height=height, gain=gain, full_image=full_image, bins=bins)
+        roi = ("full",) if full_image else (subarray_x, subarray_y, width, height)
+        return CalibrationKey(self.config_id, exposure_time_us, gain, bins, roi)
+
     def __setup_control_values(self, exposure_time, subarray_x=None, subarray_y=None, width=None, height=None,
                                gain=None, full_image=None, bins=None):
-        """Applies control values found in the config.ini unless overrides are passed in, and does error checking."""
+        """Applies control values found in the config.ini unless overrides are passed in, and does error checking.
 
-        # Load values from config.ini into variables, and override with keyword args when applicable.
-        subarray_x = subarray_x if subarray_x is not None else CONFIG_INI.getint(self.config_id, 'subarray_x')
-        subarray_y = subarray_y if subarray_y is not None else CONFIG_INI.getint(self.config_id, 'subarray_y')
-        width = width if width is not None else CONFIG_INI.getint(self.config_id, 'width')
-        height = height if height is not None else CONFIG_INI.getint(self.config_id, 'height')
-        gain = gain if gain is not None else CONFIG_INI.getint(self.config_id, 'gain')
-        full_image = full_image if full_image is not None else CONFIG_INI.getboolean(self.config_id, 'full_image')
-        bins = bins if bins is not None else CONFIG_INI.getint(self.config_id, 'bins')
+        Only the controls that changed since last applied are sent to the camera, see self.invalidate_control_state().
+        """
+
+        setup = self.__resolve_setup(exposure_time, subarray_x=subarray_x, subarray_y=subarray_y, width=width,
+                                     height=height, gain=gain, full_image=full_image, bins=bins)
+        exposure_time_us, gain, full_image, subarray_x, subarray_y, width, height, bins = setup
 
         # Set some class attributes.
         self.gain = gain
         self.bins = bins
 
+        # Nothing to do if all is as last applied.
+        if setup == self._applied_setup:
+            return
+
+        # A change of ROI changes the frame size, so (re)allocate the frame buffers upon the next video capture.
+        roi = (full_image, subarray_x, subarray_y, width, height, bins)
+        if roi != self.frame_ring_roi:
+            self.frame_ring = None
+            self.frame_ring_roi = roi
+
         # Set up our custom control values.
-        self.instrument.set_control_value(self.instrument_lib.ASI_GAIN, gain)
-        self.instrument.set_control_value(self.instrument_lib.ASI_EXPOSURE, int(exposure_time.to(units.microsecond).magnitude))
+        self.__set_control_value(self.instrument_lib.ASI_GAIN, gain)
+        self.__set_control_value(self.instrument_lib.ASI_EXPOSURE, exposure_time_us)
 
         # Store the camera's detector shape.
-        cam_info = self.instrument.get_camera_property()
+        cam_info = self.__get_camera_property()
         detector_max_x = cam_info['MaxWidth']
         detector_max_y = cam_info['MaxHeight']
 
         if full_image:
             #self.log.info("Taking full", detector_max_x, "x", detector_max_y, "image, ignoring region of interest params.")
             self.log.info("Taking full image, ignoring region of interest params.")
+            self._applied_setup = setup
             return
 
         # Check for errors, log them all before exiting.
@@ -421,9 +737,14 @@ class ZwoCamera(Camera):
 
         # Set Region of Interest.
         if not full_image:
-            self.instrument.set_roi(start_x=derived_start_x,
-                                start_y=derived_start_y,
-                                width=width,
-                                height=height,
-                                image_type=self.instrument_lib.ASI_IMG_RAW16,
-                                bins=bins)
+            applied_roi = (derived_start_x, derived_start_y, width, height, bins)
+            if applied_roi != self._applied_roi:
+                self.instrument.set_roi(start_x=derived_start_x,
+                                    start_y=derived_start_y,
+                                    width=width,
+                                    height=height,
+                                    image_type=self.instrument_lib.ASI_IMG_RAW16,
+                                    bins=bins)
+                self._applied_roi = applied_roi
+
+        self._applied_setup = setup
@@ -1,11 +1,19 @@
 from abc import ABC, abstractmethod
+import contextlib
 
+from catkit.acquisition import create_reducer, monotonic_to_epoch
+from catkit.fits_writer import FitsWriterPool
 from catkit.interfaces.Instrument import Instrument
+import catkit.util
 """Abstract base class for all cameras. Implementations of this class also become context managers."""
 
 
 class Camera(Instrument, ABC):
 
+    # Master darks & biases, see self.take_master_calibration(). Implementations supporting calibration set this to a
+    # catkit.calibration.CalibrationCache.
+    calibration = None
+
     @abstractmethod
     def take_exposures(self, exposure_time, num_exposures, path=None, filename=None, *args, **kwargs):
         """Takes exposures and should be able to save fits and simply return the image data."""
@@ -13,3 +21,118 @@ class Camera(Instrument, ABC):
     @abstractmethod
     def stream_exposures(self, exposure_time, num_exposures, *args, **kwargs):
         """ Take a stream of exposures and yield individual images (ie. a generator)."""
+
+    def calibration_key(self, exposure_time, **kwargs):
+        """
+        The catkit.calibration.CalibrationKey of the settings that exposures taken with these arguments would use.
+        :param exposure_time: Exposure time, see self.stream_exposures().
+        :param kwargs: Camera settings (gain, bins, ROI etc) as passed to self.stream_exposures().
+        :return: catkit.calibration.CalibrationKey
+        """
+        raise NotImplementedError(f"{self.__class__.__qualname__} doesn't support calibration frames.")
+
+    def take_master_calibration(self, kind, exposure_time, num_exposures=20, **kwargs):
+        """
+        Take and store a master dark or bias: the mean of num_exposures, co-added as they stream. Masters are stored in
+        self.calibration, keyed by the camera settings, from where exposures taken with the same settings can have them
+        subtracted. WARNING: The light must be blocked from reaching the camera.
+        :param kind: "dark" or "bias". Biases are used for all exposure times, so take them with the shortest possible.
+        :param exposure_time: Exposure time, see self.stream_exposures().
+        :param num_exposures: Number of exposures to average.
+        :param kwargs: Camera settings (gain, bins, ROI etc) passed to self.stream_exposures().
+        :return: The master frame.
+        """
+        if self.calibration is None:
+            raise NotImplementedError(f"{self.__class__.__qualname__} doesn't support calibration frames.")
+        master, meta_data = self.reduce_exposures(exposure_time, num_exposures, reduce="mean", **kwargs)
+        return self.calibration.put(kind, self.calibration_key(exposure_time, **kwargs), master,
+                                    num_frames=num_exposures)
+
+    def get_master_calibration(self, kind, exposure_time, **kwargs):
+        """
+        Get the stored master dark or bias for the camera settings of exposures taken with these arguments.
+        :param kind: "dark" or "bias".
+        :param exposure_time: Exposure time, see self.stream_exposures().
+        :param kwargs: Camera settings (gain, bins, ROI etc) as passed to self.stream_exposures().
+        :return: The master frame.
+        :raises LookupError: If no such master has been taken.
+        """
+        key = self.calibration_key(exposure_time, **kwargs)
+        master = None if self.calibration is None else self.calibration.get(kind, key)
+        if master is None:
+            raise LookupError(f"No master {kind} for {key}, see take_master_calibration().")
+        return master
+
+    def reduce_exposures(self, exposure_time, num_exposures, reduce="mean",
+                         file_mode=False, raw_skip=0, path=None, filename=None, writer=None, cube_mode=False,
+                         **kwargs):
+        """
+        Take exposures and reduce them as they stream, such that memory use is independent of num_exposures.
+        :param exposure_time: Exposure time, see self.stream_exposures().
+        :param num_exposures: Number of exposures.
+        :param reduce: One of "mean", "sum", "median-approx" or "mean+var", see catkit.acquisition.reducers.
+        :param file_mode: If True, each (raw_skip permitting) exposure is written to disk as it is taken.
+        :param raw_skip: Skips x writes for every one taken, see catkit.util.save_images().
+        :param path: Path of the directory to save fits files to, required if file_mode is True.
+        :param filename: Name for file, required if file_mode is True.
+        :param writer: catkit.fits_writer.FitsWriterPool to write files with in the background, which the caller is then
+                       responsible to flush. Defaults to a pool of its own, flushed before returning.
+        :param cube_mode: If True, write the exposures into a single file, as a cube, see self.save_stream().
+        :param kwargs: Passed to self.stream_exposures().
+        :return: Two parameters: The reduced image (a tuple of the mean and variance images for "mean+var"),
+                 Metadata list of MetaDataEntry objects.
+        """
+        reducer = create_reducer(reduce)
+        meta_data = None
+        with contextlib.ExitStack() as stack:
+            stream = self.stream_exposures(exposure_time, num_exposures, **kwargs)
+            if file_mode:
+                if writer is None and not cube_mode:
+                    writer = stack.enter_context(FitsWriterPool())
+                stream = self.save_stream(stream, num_exposures, path, filename, raw_skip=raw_skip, writer=writer,
+                                          cube_mode=cube_mode)
+
+            for image, meta_data, *_ in stream:
+                reducer.add(image)
+
+        return reducer.result(), meta_data
+
+    @staticmethod
+    def save_stream(stream, num_exposures, path, filename, raw_skip=0, writer=None, cube_mode=False):
+        """
+        Pass through a stream of exposures, as yielded by stream_exposures(), writing each (raw_skip permitting) to disk
+        as it goes. The fits header is built from the meta data only once.
+        :param stream: Iterable of image & meta data pairs, or triplets with the catkit.acquisition.FrameInfo of each
+                       image, e.g., as yielded with stream_exposures(frame_info=True).
+        :param num_exposures: Number of exposures in the stream.
+        :param path: Path of the directory to save fits files to.
+        :param filename: Name for file.
+        :param raw_skip: Skips x writes for every one taken, see catkit.util.save_images().
+        :param writer: Optional catkit.fits_writer.FitsWriterPool to write files with in the background.
+        :param cube_mode: If True, stream the exposures into a single file, as a cube, rather than a file per exposure.
+                          The cube is finalized once the stream ends, with the capture time of each exposure (if
+                          the stream has FrameInfos) in its "FRAMES" table. See catkit.fits_writer.FitsCubeWriter.
+        :yield: The items of the stream as is.
+        """
+        header = None
+        cube = None
+        try:
+            for i, item in enumerate(stream):
+                image, meta_data, *info = item
+                if not catkit.util.skip_raw_frame(i, raw_skip):
+                    if header is None:
+                        header = catkit.util.build_fits_header(meta_data)
+                    if cube_mode:
+                        if cube is None:
+                            num_frames = sum(not catkit.util.skip_raw_frame(j, raw_skip) for j in range(num_exposures))
+                            cube = catkit.util.open_fits_cube(meta_data, path, filename, header=header,
+                                                              num_frames=num_frames)
+                        timestamp = monotonic_to_epoch(info[0].timestamp) if info else None
+                        cube.append(image, timestamp=timestamp, frame=i + 1)
+                    else:
+                        catkit.util.save_image(image, meta_data, path, filename, frame_index=i,
+                                               num_exposures=num_exposures, writer=writer, header=header)
+                yield item
+        finally:
+            if cube is not None:
+                cube.close()
@@ -0,0 +1,78 @@
+import numpy as np
+import pytest
+
+from catkit.acquisition import FrameInfo, StreamStatistics, create_reducer
+
+
+@pytest.fixture()
+def frames():
+    rng = np.random.default_rng(seed=0)
+    return rng.normal(100, 5, size=(400, 16, 16))
+
+
+@pytest.mark.parametrize(("reduce", "expected"), (("sum", lambda frames: frames.sum(axis=0)),
+                                                  ("mean", lambda frames: frames.mean(axis=0))))
+def test_reduce(reduce, expected, frames):
+    reducer = create_reducer(reduce)
+    for frame in frames:
+        reducer.add(frame.astype(np.float32))
+    assert reducer.count == len(frames)
+    assert np.allclose(reducer.result(), expected(frames.astype(np.float32)))
+
+
+def test_mean_var(frames):
+    reducer = create_reducer("mean+var")
+    reducer.add(frames[0])
+    assert np.all(reducer.result()[1] == 0)
+    for frame in frames[1:]:
+        reducer.add(frame)
+    mean, var = reducer.result()
+    assert np.allclose(mean, frames.mean(axis=0))
+    assert np.allclose(var, frames.var(axis=0, ddof=1))
+
+
+def test_median_approx(frames):
+    # Outliers (e.g., cosmic rays) pull the mean but barely move the median.
+    frames[::10] += 1000
+    reducer = create_reducer("median-approx")
+    for frame in frames:
+        reducer.add(frame)
+    median = reducer.result()
+    assert np.abs(median - np.median(frames, axis=0)).max() < 2
+    assert np.abs(frames.mean(axis=0) - np.median(frames, axis=0)).min() > 50
+
+
+def test_reduce_errors():
+    with pytest.raises(ValueError):
+        create_reducer("mode")
+
+    reducer = create_reducer("mean")
+    with pytest.raises(ValueError):
+        reducer.result()
+    reducer.add(np.zeros((4, 4)))
+    with pytest.raises(ValueError):
+        reducer.add(np.zeros((4, 5)))
+
+
+def test_median_approx_few_frames(frames):
+    reducer = create_reducer("median-approx")
+    for frame in frames[:3]:
+        reducer.add(frame)
+    assert np.allclose(reducer.result(), np.median(frames[:3], axis=0))
+
+
+def test_stream_statistics():
+    statistics = StreamStatistics(window=4)
+    assert np.isnan(statistics.fps)
+    # 10 fps with 5ms latency, frames 3 & 4 missing, the driver dropped 2.
+    for sequence in (0, 1, 2, 5, 6):
+        statistics.add(FrameInfo(sequence, sequence * 0.1, dropped=2 if sequence > 4 else 0),
+                       consumed_at=sequence * 0.1 + 0.005)
+    summary = statistics.summary()
+    assert summary["frames"] == 5
+    assert statistics.missing_frames == 2
+    assert summary["dropped_frames"] == 4
+    # Over the last 4 frames only.
+    assert np.isclose(summary["fps"], 3 / 0.5)
+    assert np.isclose(summary["latency_p50"], 0.005)
+    assert np.isclose(summary["latency_p99"], 0.005)
@@ -0,0 +1,108 @@
+import numpy as np
+import pytest
+
+from catkit.alignment import PicomotorAlignment, calibration_matrix
+
+
+class Picomotors:
+    """ Moves a spot linearly with the steps of each axis, with backlash-free motors. """
+
+    max_step = 500
+
+    def __init__(self, response, origin=(100., 80.)):
+        self.response = np.asarray(response, dtype=float)
+        self.origin = np.asarray(origin, dtype=float)
+        self.steps = np.zeros(self.response.shape[1])
+        self.calibration = {}
+        self.moves = 0
+
+    def relative_move(self, axis, value):
+        self.move({axis: value})
+
+    def move(self, moves):
+        for axis, value in moves.items():
+            assert isinstance(value, int) and abs(value) <= self.max_step
+            self.steps[axis - 1] += value
+        self.moves += 1
+
+    @property
+    def spot(self):
+        return self.origin + self.response @ self.steps
+
+
+class Camera:
+    """ Images a Gaussian spot at the position set by the picomotors. """
+
+    def __init__(self, picomotors, shape=(160, 200), sigma=2.):
+        self.picomotors = picomotors
+        self.rows, self.columns = np.indices(shape)
+        self.sigma = sigma
+
+    def reduce_exposures(self, exposure_time, num_exposures, reduce="mean", **kwargs):
+        x, y = self.picomotors.spot
+        image = 1000 * np.exp(-((self.columns - x)**2 + (self.rows - y)**2) / (2 * self.sigma**2))
+        return image, None
+
+
+RESPONSE = [[0.05, -0.01],
+            [0.008, 0.04]]
+
+
+def test_calibrate():
+    picomotors = Picomotors(RESPONSE)
+    alignment = PicomotorAlignment(picomotors, Camera(picomotors), exposure_time=100)
+    assert np.allclose(alignment.calibrate(steps=200), RESPONSE, atol=1e-3)
+    # Moved back.
+    assert not picomotors.steps.any()
+    # The controller's calibration describes the same response, up to the sign of the moves.
+    matrix = calibration_matrix(picomotors.calibration, (1, 2))
+    assert np.allclose(np.abs(matrix), np.abs(RESPONSE), atol=1e-3)
+
+
+@pytest.mark.parametrize("roi", (None, 40))
+def test_align(roi):
+    picomotors = Picomotors(RESPONSE)
+    alignment = PicomotorAlignment(picomotors, Camera(picomotors), exposure_time=100, centroid_roi_size=roi)
+    result = alignment.align((120, 95), tolerance=0.2)
+    assert result.converged
+    assert np.hypot(*(picomotors.spot - (120, 95))) <= 0.2
+    assert result.iterations <= 4
+    assert result.history[0] == pytest.approx((100, 80), abs=0.01)
+
+
+def test_refines_stale_matrix():
+    # E.g., a thermal event rotated & scaled the response since the matrix was measured.
+    angle = np.radians(20)
+    rotation = np.array([[np.cos(angle), -np.sin(angle)], [np.sin(angle), np.cos(angle)]])
+    picomotors = Picomotors(1.3 * rotation @ RESPONSE)
+    alignment = PicomotorAlignment(picomotors, Camera(picomotors), exposure_time=100, matrix=RESPONSE)
+    result = alignment.align((125, 60), tolerance=0.2)
+    assert result.converged
+    assert result.iterations <= 6
+    assert picomotors.moves == result.iterations
+
+    # Realigning after a drift then uses the refined matrix.
+    picomotors.origin += (3, -2)
+    result = alignment.align((125, 60), tolerance=0.2)
+    assert result.converged
+    assert result.iterations <= 2
+
+
+def test_step_limits():
+    picomotors = Picomotors(RESPONSE)
+    picomotors.max_step = 100
+    alignment = PicomotorAlignment(picomotors, Camera(picomotors), exposure_time=100, matrix=RESPONSE)
+    result = alignment.align((140, 80), tolerance=0.2, max_iterations=3)
+    assert not result.converged
+    assert result.iterations == 3
+
+    # Sub-step offsets can't be corrected.
+    result = alignment.align(picomotors.spot + 0.01, tolerance=0.001)
+    assert not result.converged
+    assert result.iterations == 0
+
+
+def test_matrix_shape():
+    picomotors = Picomotors(RESPONSE)
+    with pytest.raises(ValueError):
+        PicomotorAlignment(picomotors, Camera(picomotors), exposure_time=100, axes=(1, 2, 3), matrix=RESPONSE)
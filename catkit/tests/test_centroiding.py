@@ -0,0 +1,53 @@
+import numpy as np
+import pytest
+
+from catkit import centroiding
+
+
+def spot(x, y, shape=(64, 80), sigma=2., background=0., amplitude=1000.):
+    rows, columns = np.indices(shape)
+    return background + amplitude * np.exp(-((columns - x)**2 + (rows - y)**2) / (2 * sigma**2))
+
+
+@pytest.mark.parametrize("method, accuracy", (("com", 1e-6),
+                                              ("thresholded_com", 0.05),
+                                              ("windowed_com", 0.02),
+                                              ("quadratic", 0.1)))
+def test_methods(method, accuracy):
+    for x, y in ((40.3, 30.7), (20., 45.5), (61.8, 12.2)):
+        image = spot(x, y)
+        assert centroiding.get_method(method)(image) == pytest.approx((x, y), abs=accuracy)
+
+
+@pytest.mark.parametrize("method", ("thresholded_com", "windowed_com"))
+def test_background(method):
+    image = spot(40.3, 30.7, background=100)
+    # Another, fainter source elsewhere.
+    image += spot(10, 10, amplitude=200)
+    assert centroiding.get_method(method)(image) == pytest.approx((40.3, 30.7), abs=0.05)
+    assert centroiding.center_of_mass(image) != pytest.approx((40.3, 30.7), abs=1)
+
+
+def test_roi():
+    image = spot(40.3, 30.7) + spot(10, 10)
+    x, y = centroiding.centroid(image, "com", center=(42, 28), size=20)
+    assert (x, y) == pytest.approx((40.3, 30.7), abs=0.01)
+
+    # Clipped to the image.
+    image = spot(8.2, 55.6)
+    assert centroiding.centroid(image, "com", center=(0, 63), size=20) == pytest.approx((8.2, 55.6), abs=0.01)
+
+    with pytest.raises(ValueError):
+        centroiding.centroid(image, "com", center=(0, 63))
+
+
+def test_get_method():
+    assert centroiding.get_method("quadratic") is centroiding.quadratic_peak
+    assert centroiding.get_method(np.mean) is np.mean
+    with pytest.raises(NotImplementedError):
+        centroiding.get_method("3d")
+
+
+def test_no_signal():
+    with pytest.raises(ValueError):
+        centroiding.center_of_mass(np.zeros((8, 8)))
@@ -0,0 +1,169 @@
+import enum
+import os
+
+from astropy.io import fits
+import numpy as np
+import pytest
+
+from catkit.catkit_types import MetaDataEntry, quantity, units
+import catkit.fits_writer
+from catkit.fits_writer import FitsCubeWriter, FitsWriterPool, format_card, write_raw_fits
+import catkit.util
+
+
+@pytest.mark.parametrize("dtype", (np.uint16, np.int16, np.float32, np.float64))
+def test_cube_round_trip(dtype, tmpdir):
+    filepath = os.path.join(tmpdir, "cube.fits")
+    frames = (np.arange(5 * 6 * 4).reshape(5, 6, 4) * 1000).astype(dtype)
+    header = fits.Header([("EXP_TIME", 100, "microseconds"), ("NAXIS", 2)])
+
+    with FitsCubeWriter(filepath, header=header, num_frames=len(frames)) as cube:
+        for i, frame in enumerate(frames):
+            cube.append(frame, timestamp=i * 0.5, meta={"TEMP": 20 + i})
+
+    with fits.open(filepath) as hdu_list:
+        assert np.array_equal(hdu_list[0].data, frames)
+        assert hdu_list[0].data.dtype.newbyteorder("=") == np.dtype(dtype)
+        assert hdu_list[0].header["NAXIS3"] == len(frames)
+        assert hdu_list[0].header["EXP_TIME"] == 100
+        table = hdu_list["FRAMES"].data
+        assert list(table["FRAME"]) == [1, 2, 3, 4, 5]
+        assert list(table["TIMESTAMP"]) == [0, 0.5, 1, 1.5, 2]
+        assert list(table["TEMP"]) == [20, 21, 22, 23, 24]
+
+
+def test_cube_fewer_frames(tmpdir):
+    filepath = os.path.join(tmpdir, "cube.fits")
+    with FitsCubeWriter(filepath, num_frames=10) as cube:
+        for i in range(3):
+            cube.append(np.full((8, 8), i, dtype=np.uint16))
+
+    with fits.open(filepath) as hdu_list:
+        assert hdu_list[0].data.shape == (3, 8, 8)
+        assert np.array_equal(hdu_list[0].data[:, 0, 0], [0, 1, 2])
+        assert len(hdu_list["FRAMES"].data) == 3
+        # No timestamps given, so they're undefined rather than the time of writing.
+        assert np.isnan(hdu_list["FRAMES"].data["TIMESTAMP"]).all()
+
+
+def test_cube_mismatched_frames(tmpdir):
+    with FitsCubeWriter(os.path.join(tmpdir, "cube.fits")) as cube:
+        cube.append(np.zeros((8, 8), dtype=np.uint16))
+        with pytest.raises(ValueError):
+            cube.append(np.zeros((8, 4), dtype=np.uint16))
+        with pytest.raises(ValueError):
+            cube.append(np.zeros((8, 8), dtype=np.float32))
+
+
+@pytest.mark.parametrize("value", (True, False, 0, -42, 2 ** 40, 1.5, -2.5e-12, 1e300, 0.1, "", "dummy", "it's",
+                                   "x" * 68, "'" * 34, None))
+def test_format_card(value):
+    card = format_card("KEYWORD", value, "A comment")
+    assert len(card) == 80
+    parsed = fits.Card.fromstring(card)
+    parsed.verify("exception")
+    assert parsed.keyword == "KEYWORD"
+    if isinstance(value, str):
+        assert parsed.value == value
+    elif value is None:
+        assert parsed.value == fits.card.UNDEFINED
+    else:
+        assert parsed.value == value
+        assert type(parsed.value) == type(value)
+        assert parsed.comment == "A comment"
+
+
+@pytest.mark.parametrize("value", ("x" * 69, "'" * 35, "it's a " * 40 + "long string"))
+def test_format_card_long_string(value):
+    # Continued over CONTINUE cards, as astropy does, rather than truncated.
+    cards = format_card("KEYWORD", value, "A comment")
+    assert cards == fits.Card("KEYWORD", value, "A comment").image
+    assert len(cards) % 80 == 0 and len(cards) > 80
+    header = fits.Header.fromstring(cards)
+    assert header["KEYWORD"] == value
+    assert header.comments["KEYWORD"] == "A comment"
+
+
+@pytest.mark.parametrize("memmap", (False, True))
+@pytest.mark.parametrize("dtype", (np.uint8, np.uint16, np.int16, np.int32, np.uint32, np.int64, np.float32,
+                                   np.float64))
+def test_raw_fits_round_trip(dtype, memmap, tmpdir, monkeypatch):
+    # Exercise writing in multiple chunks.
+    monkeypatch.setattr(catkit.fits_writer, "WRITE_CHUNK_SIZE", 1000)
+
+    rng = np.random.default_rng(seed=0)
+    if np.dtype(dtype).kind == "f":
+        data = rng.normal(size=(37, 53)).astype(dtype)
+    else:
+        info = np.iinfo(dtype)
+        data = rng.integers(info.min, info.max, size=(37, 53), dtype=dtype, endpoint=True)
+    metadata = [MetaDataEntry("Exposure Time", "EXP_TIME", quantity(100, units.microsecond), "microseconds"),
+                MetaDataEntry("Camera", "CAMERA", "zwo_ASI178MM", "Camera model"),
+                MetaDataEntry("Bins", "BINS", 1, "Binning for camera"),
+                MetaDataEntry("Path", "PATH", os.path.join(str(tmpdir), "a" * 100, "raw.fits"), "Path of the file")]
+    header = fits.Header([("OBSERVER", "hicat"), ("NAXIS", 7)])
+
+    raw_filepath = write_raw_fits(data, os.path.join(tmpdir, "raw.fits"), metadata=metadata, header=header,
+                                  memmap=memmap)
+    astropy_filepath = os.path.join(tmpdir, "astropy.fits")
+    hdu = fits.PrimaryHDU(data, header=header)
+    for entry in metadata:
+        hdu.header[entry.name_8chars] = (getattr(entry.value, "magnitude", entry.value), entry.comment)
+    hdu.writeto(astropy_filepath)
+
+    with fits.open(raw_filepath) as raw, fits.open(astropy_filepath) as expected:
+        raw.verify("exception")
+        assert np.array_equal(raw[0].data, expected[0].data)
+        assert raw[0].data.dtype == expected[0].data.dtype
+        # Astropy only adds EXTEND when not given a header, and BZERO/BSCALE last.
+        assert {key: value for key, value in raw[0].header.items() if key != "EXTEND"} == dict(expected[0].header)
+
+    # The data, as stored, is byte for byte that written by astropy.
+    with open(raw_filepath, "rb") as raw, open(astropy_filepath, "rb") as expected:
+        raw_bytes = raw.read()
+        expected_bytes = expected.read()
+    assert len(raw_bytes) == len(expected_bytes)
+    assert len(raw_bytes) % 2880 == 0
+    assert raw_bytes[-data.nbytes - (-data.nbytes % 2880):] == expected_bytes[-data.nbytes - (-data.nbytes % 2880):]
+
+
+def test_raw_fits_metadata_overrides_header(tmpdir):
+    filepath = write_raw_fits(np.zeros((4, 4), dtype=np.float32), os.path.join(tmpdir, "raw.fits"),
+                              header=fits.Header([("GAIN", 1)]),
+                              metadata=[MetaDataEntry("Gain", "GAIN", 2, "Gain"), MetaDataEntry("Gain", "GAIN", 3, "")])
+    header = fits.getheader(filepath)
+    assert header["GAIN"] == 3
+    assert list(header.keys()).count("GAIN") == 1
+
+
+def test_raw_fits_only_unwraps_quantities(tmpdir):
+    class Filter(enum.Enum):
+        CLEAR = 1
+
+    with pytest.raises(TypeError):
+        write_raw_fits(np.zeros((4, 4), dtype=np.float32), os.path.join(tmpdir, "raw.fits"),
+                       metadata=[MetaDataEntry("Filter", "FILTER", Filter.CLEAR, "Filter")])
+
+
+def test_raw_fits_fallback(tmpdir):
+    data = np.array([[-1, 1]], dtype=np.int8)
+    filepath = write_raw_fits(data, os.path.join(tmpdir, "raw.fits"))
+    assert np.array_equal(fits.getdata(filepath), data)
+
+
+def test_writer(tmpdir):
+    images = [np.full((5, 5), i) for i in range(10)]
+    with FitsWriterPool(max_queued=2) as writer:
+        catkit.util.save_images(images, None, tmpdir, "dummy.fits", writer=writer)
+        writer.flush()
+        for i in range(len(images)):
+            assert fits.getdata(os.path.join(tmpdir, f"dummy_frame{i + 1}.fits"))[0, 0] == i
+
+
+def test_writer_error(tmpdir):
+    with FitsWriterPool() as writer:
+        catkit.util.save_images([np.zeros((5, 5))], None, tmpdir, "dummy.fits", writer=writer)
+        writer.write(np.zeros((5, 5)), "not a header", os.path.join(tmpdir, "bad.fits"))
+        with pytest.raises(Exception):
+            writer.flush()
+        assert os.path.isfile(os.path.join(tmpdir, "dummy.fits"))
@@ -6,6 +6,7 @@ import numpy as np
 import pytest
 from astropy.io import fits
 
+from catkit.catkit_types import MetaDataEntry
 import catkit.util
 
 
@@ -102,3 +103,104 @@ class TestSaveImages:
         assert(meta_data)
         assert(meta_data[0].name == "PATH")
         assert(os.path.isfile(meta_data[0].value))
+
+    def test_meta_data_does_not_grow(self, tmpdir):
+        meta_data = [MetaDataEntry("Exposure Time", "EXP_TIME", 100, "microseconds")]
+        catkit.util.save_images([np.zeros((5, 5))] * 3, meta_data, tmpdir, "dummy.fits")
+        catkit.util.save_images([np.zeros((5, 5))] * 3, meta_data, tmpdir, "dummy.fits")
+        assert [entry.name for entry in meta_data] == ["Exposure Time", "PATH", "FRAME", "FILENAME"]
+        assert meta_data[2].value == 3
+
+        header = fits.getheader(os.path.join(tmpdir, "dummy_frame2.fits"))
+        assert header["FRAME"] == 2
+        assert header["EXP_TIME"] == 100
+
+    @pytest.mark.parametrize("raw_skip", (0, 2))
+    def test_cube_mode(self, raw_skip, tmpdir):
+        images = [np.full((5, 5), i, dtype=np.float32) for i in range(7)]
+        meta_data = [MetaDataEntry("Exposure Time", "EXP_TIME", 100, "microseconds")]
+        timestamps = [1600000000 + i * 0.5 for i in range(len(images))]
+        catkit.util.save_images(images, meta_data, tmpdir, "dummy", raw_skip=raw_skip, cube_mode=True,
+                                timestamps=timestamps)
+        assert glob.glob(os.path.join(tmpdir, "*.fits")) == [os.path.join(tmpdir, "dummy.fits")]
+        assert meta_data[1].name == "PATH"
+
+        with fits.open(meta_data[1].value) as hdu_list:
+            expected_frames = list(range(0, len(images), raw_skip + 1))
+            assert np.array_equal(hdu_list[0].data[:, 0, 0], expected_frames)
+            assert hdu_list[0].header["EXP_TIME"] == 100
+            assert list(hdu_list["FRAMES"].data["FRAME"]) == [i + 1 for i in expected_frames]
+            assert list(hdu_list["FRAMES"].data["TIMESTAMP"]) == [timestamps[i] for i in expected_frames]
+
+
+class TestOrientImage:
+
+    @pytest.mark.parametrize("theta", (0, 90, 180, 270))
+    @pytest.mark.parametrize("flip", (True, False))
+    def test_matches_rotate_and_flip(self, theta, flip):
+        data = np.arange(6 * 8, dtype=np.uint16).reshape(6, 8)
+        image = catkit.util.orient_image(data, theta, flip)
+        assert image.dtype == np.float32
+        assert image.flags.c_contiguous
+        assert np.array_equal(image, catkit.util.rotate_and_flip_image(data, theta, flip))
+
+    def test_out(self):
+        data = np.arange(6 * 8, dtype=np.uint16).reshape(6, 8)
+        out = np.empty((8, 6), dtype=np.float32)
+        image = catkit.util.orient_image(data, 90, True, out=out)
+        assert image is out
+        assert np.array_equal(out, np.fliplr(np.rot90(data)))
+
+        with pytest.raises(ValueError):
+            catkit.util.orient_image(data, 0, True, out=out)
+        with pytest.raises(ValueError):
+            catkit.util.orient_image(data, 90, True, out=np.empty((6, 8), dtype=np.float32).T)
+
+    def test_dark(self):
+        data = np.arange(6 * 8, dtype=np.uint16).reshape(6, 8)
+        dark = np.full((8, 6), 0.5, dtype=np.float32)
+        image = catkit.util.orient_image(data, 90, True, dark=dark)
+        assert np.array_equal(image, np.fliplr(np.rot90(data)) - 0.5)
+
+        with pytest.raises(ValueError):
+            catkit.util.orient_image(data, 0, True, dark=dark)
+
+
+class TestBinImage:
+
+    @pytest.mark.parametrize("bins", (1, 2, 3, (2, 4), (1, 3), (5, 1)))
+    @pytest.mark.parametrize("method", ("sum", "mean"))
+    def test_bin_image(self, bins, method):
+        data = np.arange(30 * 41, dtype=np.uint16).reshape(30, 41)
+        bins_y, bins_x = (bins, bins) if np.isscalar(bins) else bins
+        height, width = 30 // bins_y, 41 // bins_x
+        blocks = data[:height * bins_y, :width * bins_x].reshape(height, bins_y, width, bins_x)
+        expected = getattr(blocks, method)(axis=(1, 3))
+
+        image = catkit.util.bin_image(data, bins, method=method)
+        assert image.dtype == np.float32
+        assert np.allclose(image, expected)
+
+        out = np.empty((height, width), dtype=np.float64)
+        assert catkit.util.bin_image(data, bins, method=method, out=out) is out
+        assert np.allclose(out, expected)
+
+    def test_bin_image_errors(self):
+        data = np.zeros((8, 8))
+        with pytest.raises(ValueError):
+            catkit.util.bin_image(data, 2, method="median")
+        with pytest.raises(ValueError):
+            catkit.util.bin_image(data, 0)
+        with pytest.raises(ValueError):
+            catkit.util.bin_image(data, 2, out=np.empty((8, 8)))
+
+
+class TestCropImage:
+
+    def test_crop_image(self):
+        data = np.arange(10 * 12).reshape(10, 12)
+        roi = catkit.util.crop_image(data, center_x=6, center_y=4, width=4, height=6)
+        assert np.may_share_memory(roi, data)
+        assert np.array_equal(roi, data[1:7, 4:8])
+        with pytest.raises(ValueError):
+            catkit.util.crop_image(data, center_x=6, center_y=4, width=4, height=10)
@@ -10,6 +10,7 @@ import numpy as np
 from astropy.io import fits
 
 from catkit.catkit_types import quantity
+from catkit.fits_writer import FitsCubeWriter, write_raw_fits
 
 
 simulation = False
@@ -44,13 +45,14 @@ def safe_divide(a, b):
     return c
 
 
-def write_fits(data, filepath, header=None, metadata=None):
+def write_fits(data, filepath, header=None, metadata=None, memmap=False):
     """
     Writes a fits file and adds header and metadata when necessary.
     :param data: numpy data (aka image)
     :param filepath: path to save the file, include filename.
     :param header: astropy hdu.header.
     :param metadata: list of MetaDataEntry objects that will get added to header.
+    :param memmap: If True, write the data through a numpy.memmap of the file, see fits_writer.write_raw_fits().
     :return: filepath
     """
     log = logging.getLogger()
@@ -61,12 +63,7 @@ def write_fits(data, filepath, header=None, metadata=None):
     if not os.path.exists(os.path.dirname(filepath)):
         os.makedirs(os.path.dirname(filepath))
 
-    # Create a PrimaryHDU object to encapsulate the data.
-    hdu = fits.PrimaryHDU(data)
-    if header is not None:
-        hdu.header = header
-
-    # Add metadata to header.
+    # Check that the metadata fits in the header.
     if metadata is not None:
         for entry in metadata:
             if len(entry.name_8chars) > 8:
@@ -75,11 +72,9 @@ def write_fits(data, filepath, header=None, metadata=None):
             if len(entry.comment) > 47:
                 log.warning("Fits Header comment for " + entry.name_8chars +
                       " is greater than 47 characters and will be truncated.")
-            hdu.header[entry.name_8chars[:8]] = (entry.value, entry.comment)
 
-    # Create a HDUList to contain the newly created primary HDU, and write to a new file.
-    fits.HDUList([hdu])
-    hdu.writeto(filepath, overwrite=True)
+    # Format the header and write the data directly, astropy's HDU machinery being slow for large images.
+    write_raw_fits(data, filepath, metadata=metadata, header=header, memmap=memmap)
 
     log.info("Wrote " + filepath)
     return filepath
@@ -101,11 +96,109 @@ def rotate_and_flip_image(data, theta, flip):
     return data_corr
 
 
-def save_images(images, meta_data, path, base_filename, raw_skip=0):
+def orient_image(data, theta, flip, out=None, dtype=np.float32, dark=None):
+    """
+    Converts an image based on rotation and flip parameters, as rotate_and_flip_image() does, but into a C-contiguous
+    array of the given dtype, e.g., raw uint16 camera frames to float32. The type conversion and reorientation are
+    fused, such that each pixel is read and written only once.
+    :param data: Numpy array of image data.
+    :param theta: Rotation in degrees of the mounted camera, only these discrete values {0, 90, 180, 270}
+    :param flip: Boolean for whether to flip the data using np.fliplr.
+    :param out: Optional preallocated, C-contiguous output array of the oriented shape, e.g., to reuse between frames.
+    :param dtype: Data type of the output when out is None.
+    :param dark: Optional (already oriented) dark or bias frame to subtract, in the same pass.
+    :return: Converted numpy array (out, if given).
+    """
+    data_corr = rotate_and_flip_image(data, theta, flip)
+
+    if out is None:
+        out = np.empty(data_corr.shape, dtype=dtype)
+    elif out.shape != data_corr.shape:
+        raise ValueError(f"Expected an output array of shape '{data_corr.shape}' but got '{out.shape}'")
+    elif not out.flags.c_contiguous:
+        raise ValueError("Expected a C-contiguous output array.")
+
+    if dark is None:
+        np.copyto(out, data_corr, casting="unsafe")
+    elif dark.shape != out.shape:
+        raise ValueError(f"Expected a dark of shape '{out.shape}' but got '{dark.shape}'")
+    else:
+        np.subtract(data_corr, dark, out=out, casting="unsafe")
+    return out
+
+
+def bin_image(data, bins, method="sum", out=None, dtype=np.float32):
+    """
+    Bins an image into blocks of bins pixels, e.g., for a binning other than (or unsupported by) the camera's hardware.
+    Trailing rows & columns that don't fill a whole bin are discarded, as they are by hardware binning. Each strided
+    (reshaped) phase of the bins is accumulated in place, which is much faster than reducing over the axes of the
+    reshaped image, and only a single scratch array of (rows // bins_y, columns) is needed, none if bins_y == 1.
+    :param data: Numpy array of image data.
+    :param bins: Integer, or (bins_y, bins_x) tuple for non-square bins.
+    :param method: "sum" or "mean" of the pixels within each bin.
+    :param out: Optional preallocated output array of the binned shape, e.g., to reuse between frames.
+    :param dtype: Data type of the output (and accumulation) when out is None.
+    :return: Binned numpy array (out, if given).
+    """
+    if method not in ("sum", "mean"):
+        raise ValueError(f"Expected method to be one of 'sum' or 'mean' but got '{method}'")
+    bins_y, bins_x = (bins, bins) if np.isscalar(bins) else bins
+    if bins_y < 1 or bins_x < 1:
+        raise ValueError(f"Expected bins >= 1 but got '{bins}'")
+
+    data = np.asarray(data)
+    height, width = data.shape[0] // bins_y, data.shape[1] // bins_x
+    if out is None:
+        out = np.empty((height, width), dtype=dtype)
+    elif out.shape != (height, width):
+        raise ValueError(f"Expected an output array of shape '{(height, width)}' but got '{out.shape}'")
+
+    # Sum the rows of each bin, then the columns.
+    if bins_y == 1:
+        rows = data
+    else:
+        rows = np.empty((height, data.shape[1]), dtype=out.dtype)
+        np.copyto(rows, data[0:height * bins_y:bins_y], casting="unsafe")
+        for i in range(1, bins_y):
+            np.add(rows, data[i:height * bins_y:bins_y], out=rows, casting="unsafe")
+    np.copyto(out, rows[:, 0:width * bins_x:bins_x], casting="unsafe")
+    for i in range(1, bins_x):
+        np.add(out, rows[:, i:width * bins_x:bins_x], out=out, casting="unsafe")
+
+    if method == "mean":
+        np.divide(out, bins_y * bins_x, out=out, casting="unsafe")
+    return out
+
+
+def crop_image(data, center_x, center_y, width, height):
+    """
+    Extracts a region of interest, as the cameras derive them from their subarray parameters.
+    :param data: Numpy array of image data.
+    :param center_x: X coordinate of the center pixel of the region.
+    :param center_y: Y coordinate of the center pixel of the region.
+    :param width: Width of the region.
+    :param height: Height of the region.
+    :return: View of the region within data, i.e., not a copy.
+    """
+    start_x = center_x - width // 2
+    start_y = center_y - height // 2
+    if start_x < 0 or start_y < 0 or start_x + width > data.shape[1] or start_y + height > data.shape[0]:
+        raise ValueError(f"Region of {width} x {height} pixels centered on ({center_x}, {center_y}) is off the image "
+                         f"of shape '{data.shape}'")
+    return data[start_y:start_y + height, start_x:start_x + width]
+
+
+def save_images(images, meta_data, path, base_filename, raw_skip=0, writer=None, cube_mode=False, timestamps=None):
     """
     :param raw_skip: Skips x writes for every one taken. np.isinf(raw_skip) will skip all and save nothing.
     :param path: Path of the directory to save fits file to.
     :param base_filename: Name for file.
+    :param writer: Optional catkit.fits_writer.FitsWriterPool to write the files in the background. Files are then
+                   only guaranteed to be on disk once writer.flush() returns.
+    :param cube_mode: If True, write all (raw_skip permitting) images into a single file, as a cube, rather than a file
+                      per image. See catkit.fits_writer.FitsCubeWriter.
+    :param timestamps: Optional capture time (seconds since the epoch) of each image, recorded in the cube's "FRAMES"
+                       table by cube_mode, otherwise left undefined.
     :return: None
     """
 
@@ -121,78 +214,164 @@ def save_images(images, meta_data, path, base_filename, raw_skip=0):
     if np.isinf(raw_skip):
         return
 
+    # The meta data is the same for all frames, so build the header only once.
+    header = build_fits_header(meta_data)
+    num_exposures = len(images)
+
+    if cube_mode:
+        num_frames = sum(not skip_raw_frame(i, raw_skip) for i in range(num_exposures))
+        with open_fits_cube(meta_data, path, base_filename, header=header, num_frames=num_frames) as cube:
+            for i, img in enumerate(images):
+                if not skip_raw_frame(i, raw_skip):
+                    cube.append(img, timestamp=None if timestamps is None else timestamps[i], frame=i + 1)
+        return
+
+    for i, img in enumerate(images):
+        # Skip writing the fits files per the raw_skip value, and keep img data in memory.
+        if skip_raw_frame(i, raw_skip):
+            continue
+        save_image(img, meta_data, path, base_filename, frame_index=i, num_exposures=num_exposures, writer=writer,
+                   header=header)
+
+
+def skip_raw_frame(frame_index, raw_skip):
+    """
+    Whether save_images() skips writing the frame at the given index, i.e., raw_skip frames are skipped for every one
+    written, starting with writing the 1st.
+    :param frame_index: Index of the frame in the sequence of exposures.
+    :param raw_skip: Skips x writes for every one taken. np.isinf(raw_skip) will skip all.
+    :return: Boolean
+    """
+    if isinstance(raw_skip, str):
+        raw_skip = float(raw_skip)
+    if np.isinf(raw_skip):
+        return True
+    return frame_index % (int(raw_skip) + 1) != 0
+
+
+def build_fits_header(meta_data):
+    """
+    Build a fits header from meta data, e.g., once as a template for all frames of a sequence of exposures.
+    :param meta_data: astropy.io.fits.Header or list of MetaDataEntry objects (or None).
+    :return: astropy.io.fits.Header
+    """
+    header = fits.Header()
+
+    # The meta data could be an astropy.io.fits.Header or a list of MetaDataEntrys.
+    if isinstance(meta_data, fits.Header):
+        header.update(meta_data)
+    elif isinstance(meta_data, list):
+        log = logging.getLogger()
+        for entry in meta_data:
+            if not isinstance(entry, MetaDataEntry):
+                raise TypeError(f"Expected '{MetaDataEntry.__qualname__}' but got '{type(MetaDataEntry)}'")
+            if len(entry.name_8chars) > 8:
+                log.warning("Fits Header Keyword: " + entry.name_8chars +
+                            " is greater than 8 characters and will be truncated.")
+            if len(entry.comment) > 47:
+                log.warning("Fits Header comment for " + entry.name_8chars +
+                            " is greater than 47 characters and will be truncated.")
+            value = entry.value.magnitude if isinstance(entry.value, quantity) else entry.value
+            header[entry.name_8chars[:8]] = (value, entry.comment)
+
+    return header
+
+
+def open_fits_cube(meta_data, path, base_filename, header=None, num_frames=None):
+    """
+    Open a catkit.fits_writer.FitsCubeWriter to stream a sequence of exposures into, as a single fits file.
+    :param meta_data: astropy.io.fits.Header or list of MetaDataEntry objects, updated with the path of the file.
+    :param path: Path of the directory to save fits file to.
+    :param base_filename: Name for file.
+    :param header: Header template of meta_data, see build_fits_header().
+    :param num_frames: Expected number of frames in the cube.
+    :return: catkit.fits_writer.FitsCubeWriter, to be closed by the caller.
+    """
+    full_path, filename = _fits_path(path, base_filename)
+    header = build_fits_header(meta_data) if header is None else header.copy()
+    header["FILENAME"] = filename
+    header["PATH"] = full_path  # Add file Path for introspection.
+    _update_file_metadata(meta_data, full_path, filename, frame=None)
+    return FitsCubeWriter(full_path, header=header, num_frames=num_frames)
+
+
+def _fits_path(path, base_filename, frame_index=None):
+    """ The path & filename to save an exposure, or the frame_index of a sequence of exposures, to. """
+
     # Check that path and filename are specified.
     if path is None or base_filename is None:
         raise Exception("You need to specify path and filename.")
 
-    log = logging.getLogger()
     filename = base_filename
     # Check for fits extension.
     if not base_filename.endswith((".fit", ".fits")):
         filename += ".fits"
 
-    # Split the filename once here, code below may append _frame=xxx to basename.
-    file_root, file_ext = os.path.splitext(filename)
-
     # Create directory if it doesn't exist.
     if not os.path.exists(path):
         os.makedirs(path)
 
-    num_exposures = len(images)
+    # For multiple exposures append frame number to end of base file name.
+    if frame_index is not None:
+        file_root, file_ext = os.path.splitext(filename)
+        filename = file_root + "_frame" + str(frame_index + 1) + file_ext
+    return os.path.join(path, filename), filename
+
+
+def _update_file_metadata(meta_data, full_path, filename, frame=None):
+    """ Add the file info to meta_data so that it persist beyond saving, replacing that of any previous frame. """
+    if isinstance(meta_data, fits.Header):
+        meta_data["PATH"] = full_path
+        if frame is not None:
+            meta_data["FRAME"] = frame
+        meta_data["FILENAME"] = filename
+    elif isinstance(meta_data, list):
+        file_entries = [MetaDataEntry("PATH", "PATH", full_path, "File path on disk")]
+        if frame is not None:
+            file_entries.append(MetaDataEntry("FRAME", "FRAME", frame, "Frame"))
+        file_entries.append(MetaDataEntry("FILENAME", "FILENAME", full_path, "Filename"))
+        for file_entry in file_entries:
+            for i, entry in enumerate(meta_data):
+                if isinstance(entry, MetaDataEntry) and entry.name_8chars == file_entry.name_8chars:
+                    meta_data[i] = file_entry
+                    break
+            else:
+                meta_data.append(file_entry)
+
+
+def save_image(img, meta_data, path, base_filename, frame_index=0, num_exposures=1, writer=None, header=None):
+    """
+    Write a single frame of a sequence of exposures, as save_images() does. This allows frames to be written to disk as
+    they are streamed, rather than first collecting them all.
+    :param img: Numpy data of the frame.
+    :param meta_data: astropy.io.fits.Header or list of MetaDataEntry objects, updated with the path of the file.
+    :param path: Path of the directory to save fits file to.
+    :param base_filename: Name for file.
+    :param frame_index: Index of the frame in the sequence of exposures.
+    :param num_exposures: Number of exposures in the sequence. For multiple exposures, the frame number is appended to
+                          base_filename.
+    :param writer: Optional catkit.fits_writer.FitsWriterPool to write the file in the background.
+    :param header: Header template of meta_data, see build_fits_header(), to save rebuilding it for every frame.
+    :return: The path of the (to be) written file.
+    """
 
-    skip_counter = 0
-    for i, img in enumerate(images):
+    # For multiple exposures append frame number to end of base file name.
+    full_path, filename = _fits_path(path, base_filename, frame_index=frame_index if num_exposures > 1 else None)
 
-        # For multiple exposures append frame number to end of base file name.
-        if num_exposures > 1:
-            filename = file_root + "_frame" + str(i + 1) + file_ext
-        full_path = os.path.join(path, filename)
+    # Add the per frame cards to (a copy of) the template.
+    header = build_fits_header(meta_data) if header is None else header.copy()
+    header["FRAME"] = frame_index + 1
+    header["FILENAME"] = filename
+    header["PATH"] = full_path  # Add file Path for introspection.
 
-        # Skip writing the fits files per the raw_skip value, and keep img data in memory.
-        if raw_skip != 0:
-            if skip_counter == (raw_skip + 1):
-                skip_counter = 0
-            if skip_counter == 0:
-                # Write fits.
-                skip_counter += 1
-            elif skip_counter > 0:
-                # Skip fits.
-                skip_counter += 1
-                continue
-
-        # Create a PrimaryHDU object to encapsulate the data.
-        hdu = fits.PrimaryHDU(img)
-
-        # Add header info.
-        hdu.header["FRAME"] = i + 1
-        hdu.header["FILENAME"] = filename
-        hdu.header["PATH"] = full_path  # Add file Path for introspection.
-
-        # The meta data could be an astropy.io.fits.Header or a list of MetaDataEntrys.
-        if isinstance(meta_data, fits.Header):
-            # Add this info to meta_data so that it persist beyond this call.
-            meta_data["PATH"] = full_path
-            meta_data["FRAME"] = i + 1
-            meta_data["FILENAME"] = filename
-            hdu.header.update(meta_data)
-        elif isinstance(meta_data, list):
-            meta_data.append((MetaDataEntry("PATH", "PATH", full_path, "File path on disk")))
-            meta_data.append((MetaDataEntry("FRAME", "FRAME", i + 1, "Frame")))
-            meta_data.append((MetaDataEntry("FILENAME", "FILENAME", full_path, "Filename")))
-            for entry in meta_data:
-                if not isinstance(entry, MetaDataEntry):
-                    raise TypeError(f"Expected '{MetaDataEntry.__qualname__}' but got '{type(MetaDataEntry)}'")
-                if len(entry.name_8chars) > 8:
-                    log.warning("Fits Header Keyword: " + entry.name_8chars +
-                                " is greater than 8 characters and will be truncated.")
-                if len(entry.comment) > 47:
-                    log.warning("Fits Header comment for " + entry.name_8chars +
-                                " is greater than 47 characters and will be truncated.")
-                value = entry.value.magnitude if isinstance(entry.value, quantity) else entry.value
-                hdu.header[entry.name_8chars[:8]] = (value, entry.comment)
-
-        hdu.writeto(full_path, overwrite=True)
-        log.info(f"'{full_path}' written to disk.")
+    _update_file_metadata(meta_data, full_path, filename, frame=frame_index + 1)
+
+    if writer is not None:
+        writer.write(img, header, full_path)
+    else:
+        write_raw_fits(img, full_path, header=header)
+        logging.getLogger().info(f"'{full_path}' written to disk.")
+    return full_path
 
 
 def str2bool(buffer):